@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class Chip8;
+
+#define AUDIO_SAMPLE_RATE 44100
+#define AUDIO_FRAME_SAMPLES (AUDIO_SAMPLE_RATE / 60) // per emulated frame
+#define AUDIO_RING_SAMPLES 4096 // about 90ms, a power of two
+#define AUDIO_AMPLITUDE 0.25f
+#define AUDIO_BEEP_FREQUENCY 350 // Hz, CHIP-8 and SUPER-CHIP
+#define AUDIO_TABLE_SIZE 256     // samples in one period of the beep
+
+// Single producer, single consumer ring of mono float samples. Storage is
+// allocated once up front; neither side ever blocks or allocates.
+class Audio_ring {
+private:
+  std::vector<float> samples;
+  uint32_t mask;
+  alignas(64) std::atomic<uint32_t> head; // next write, producer owned
+  alignas(64) std::atomic<uint32_t> tail; // next read, consumer owned
+
+public:
+  Audio_ring(uint32_t); // capacity, a power of two
+  uint32_t write(const float *, uint32_t); // returns samples that fit
+  uint32_t read(float *, uint32_t);        // returns samples available
+  uint32_t size() const;
+
+  Audio_ring(const Audio_ring &) = delete;
+  Audio_ring &operator=(const Audio_ring &) = delete;
+};
+
+// Turns a machine's sound timer into samples, one emulated frame at a time.
+// CHIP-8 and SUPER-CHIP beep with a square wave read from a precomputed
+// table; XO-CHIP plays its 128-bit audio pattern at the FX3A pitch once
+// F002 has loaded one.
+class Audio_synth {
+private:
+  float beep[AUDIO_TABLE_SIZE];
+  uint32_t pattern_step[256]; // phase step per sample for each pitch
+  uint32_t beep_step;
+  uint32_t phase; // through one beep period or one pattern, 2^32 = whole
+
+public:
+  Audio_synth();
+  // Adds AUDIO_FRAME_SAMPLES of chip's sound to ring, or nothing while
+  // the sound timer is off. Samples that don't fit are dropped.
+  void render_frame(const Chip8 &, Audio_ring &);
+};
@@ -1,7 +1,15 @@
 #pragma once
 
-#include "sdl.hpp"
+#include "debugger.hpp"
+#include "disassembler.hpp"
+#include "framebuffer.hpp"
+#include "profiler.hpp"
+#include "rom.hpp"
+#include "snapshot.hpp"
+#include "structs.hpp"
+#include "trace.hpp"
 #include <cstdint>
+#include <vector>
 
 enum EmuState {
   RUNNING,
@@ -9,29 +17,204 @@ enum EmuState {
   QUIT
 };
 
+class Chip8;
+typedef void (*Handler)(Chip8 &, const Instruction &);
+typedef Handler (*Decoder)(uint16_t);
+
+// One predecoded instruction: operands already split out plus the handler
+// that executes it. A null handler marks an entry that needs decoding.
+typedef struct {
+  Handler handler;
+  Instruction op;
+} Decoded;
+
+// A straight-line run of predecoded instructions, compiled on first visit.
+// It ends at the first jump, call, return, DXYN or memory store; skips are
+// kept inside as side exits.
+typedef struct {
+  uint16_t length; // number of instructions, 0 if not compiled yet
+  uint16_t pure;   // leading instructions that only touch registers
+  uint32_t first;  // index of the first instruction in block_ops
+} Block;
+
+#define MEM_SIZE 0x10000 // XO-CHIP; the others only address the first 4 KB
+#define BIG_FONT_ADDR 0x0A0 // FX30 digits, 10 bytes each
+
+#define MAX_BLOCK_LENGTH 64
+#define MAX_IDLE_LOOP 256 // longest idle loop run_blocks looks for
+
+// Interpreter core: memory, registers, timers and the framebuffer. Has no
+// host dependency so it can be driven by any frontend (or none at all).
 class Chip8 {
 private:
   EmuState state;
-  uint8_t mem[4096];
-  bool display[32][64];
+  uint8_t mem[MEM_SIZE];
+  uint32_t mem_size; // bytes config.platform can address
+  Display display;
+  Resolution resolution;
+  uint8_t planes;        // planes drawn to, bit n = plane n (XO-CHIP FN01)
+  uint64_t frame_dirty;  // rows changed by 00E0/DXYN this frame, bit n = row n
+  uint64_t dirty_rows;   // rows changed since the last take_dirty_rows()
+  uint64_t display_version; // frames in which the display changed
   uint16_t pc;
   uint16_t i;
-  uint16_t stack[12];
-  uint16_t *stp;
+  uint16_t stack[16];
+  uint8_t stack_size; // 12 on the VIP, 16 on SUPER-CHIP and XO-CHIP
+  uint8_t sp; // next free stack slot
   uint8_t delay;
   uint8_t sound;
   uint8_t gpr[16];
+  uint8_t rpl[16];     // SUPER-CHIP/XO-CHIP flag registers, FX75/FX85
+  uint8_t pattern[16]; // XO-CHIP audio pattern, 128 one-bit samples
+  uint8_t pitch;       // XO-CHIP pattern rate, 4000 * 2^((pitch - 64) / 48)
   bool keypad[16];
   bool is_sound_active;
+  uint32_t rng_state; // xorshift32, never zero
+  uint64_t rom_hash;  // FNV-1a of the ROM file
   config_t config;
-  SDL_app sdl;
-  Instruction opcode;
+  Decoder decoder;  // decode<> for config.quirks and config.platform
+  bool vblank_wait; // DXYN asked to end the frame (QUIRK_DISPLAY_WAIT)
+  Decoded decoded[MEM_SIZE]; // decode cache, indexed by pc
+  Block blocks[MEM_SIZE]; // compiled blocks, indexed by start pc
+  std::vector<Decoded> block_ops;
+  bool block_code[MEM_SIZE]; // bytes covered by some compiled block
+  bool blocks_stale;      // code under a block was written, flush before use
+  uint64_t cycle_count;
+  uint64_t frame_count;
+  uint64_t machine_cycles; // emulated cost under TIMING_VIP
+  uint32_t cycle_debt;     // cycles the last frame overran into this one
+  Profiler *profiler;      // fed with CHIP8_PROFILE builds, may be null
+  Debugger *debugger;      // may be null
+  Tracer *tracer;          // may be null
+  uint32_t frame_spent;    // instructions a debugger stop cut a frame at
+  bool frame_held;         // the last frame was stopped before its end
+
+  void write_mem(uint16_t, uint8_t);
+  uint8_t random_byte();
+  void flush_blocks();
+  void compile_block(uint16_t);
+  uint32_t execute_block(uint16_t, uint32_t);
+  uint32_t run_blocks(uint32_t);
+  uint32_t run_cycles(uint32_t);
+  uint32_t execute_frame(uint32_t);
+  uint32_t run_debug(uint32_t);
+  void trace(uint16_t, uint16_t, const uint8_t *, uint16_t);
+  template <bool display_wait> uint32_t run_cached(uint32_t);
+  bool same_machine(const Chip8 &) const;
+  void set_platform(Platform);
+  void set_resolution(Resolution);
+  void scroll_vertical(int32_t);
+  void scroll_horizontal(int32_t);
+  template <Platform platform> void skip();
+  template <uint32_t quirks, Platform platform>
+  void draw_sprite(const Instruction &);
+  static bool ends_block(uint16_t);
+  static bool is_register_only(uint16_t);
+  static Decoder decoder_for(Platform, uint32_t);
+
+  // One decoder per platform and quirk set, each returning handlers with
+  // both compiled in, so the hot path never tests a quirk flag.
+  template <Platform platform, uint32_t quirks>
+  static Handler decode(uint16_t);
+
+  // Plain function pointer wrapper around an opcode member, so the decode
+  // cache holds one word per handler and dispatch is a direct indirect call.
+  template <void (Chip8::*op_fn)(const Instruction &)>
+  static void dispatch(Chip8 &chip, const Instruction &op) {
+    (chip.*op_fn)(op);
+  }
+
+  void op_nop(const Instruction &);
+  void op_00E0(const Instruction &);
+  void op_00CN(const Instruction &);
+  void op_00DN(const Instruction &);
+  void op_00EE(const Instruction &);
+  void op_00FB(const Instruction &);
+  void op_00FC(const Instruction &);
+  void op_00FD(const Instruction &);
+  void op_00FE(const Instruction &);
+  void op_00FF(const Instruction &);
+  void op_0230(const Instruction &);
+  void op_1NNN(const Instruction &);
+  void op_1260(const Instruction &);
+  void op_2NNN(const Instruction &);
+  template <Platform platform> void op_3XNN(const Instruction &);
+  template <Platform platform> void op_4XNN(const Instruction &);
+  template <Platform platform> void op_5XY0(const Instruction &);
+  void op_5XY2(const Instruction &);
+  void op_5XY3(const Instruction &);
+  void op_6XNN(const Instruction &);
+  void op_7XNN(const Instruction &);
+  void op_8XY0(const Instruction &);
+  template <uint32_t quirks> void op_8XY1(const Instruction &);
+  template <uint32_t quirks> void op_8XY2(const Instruction &);
+  template <uint32_t quirks> void op_8XY3(const Instruction &);
+  void op_8XY4(const Instruction &);
+  void op_8XY5(const Instruction &);
+  template <uint32_t quirks> void op_8XY6(const Instruction &);
+  void op_8XY7(const Instruction &);
+  template <uint32_t quirks> void op_8XYE(const Instruction &);
+  template <Platform platform> void op_9XY0(const Instruction &);
+  void op_ANNN(const Instruction &);
+  template <uint32_t quirks> void op_BNNN(const Instruction &);
+  void op_CXNN(const Instruction &);
+  template <uint32_t quirks, Platform platform>
+  void op_DXYN(const Instruction &);
+  template <Platform platform> void op_EX9E(const Instruction &);
+  template <Platform platform> void op_EXA1(const Instruction &);
+  void op_F000(const Instruction &);
+  void op_FN01(const Instruction &);
+  void op_F002(const Instruction &);
+  void op_FX07(const Instruction &);
+  void op_FX0A(const Instruction &);
+  void op_FX15(const Instruction &);
+  void op_FX18(const Instruction &);
+  void op_FX1E(const Instruction &);
+  void op_FX29(const Instruction &);
+  void op_FX30(const Instruction &);
+  void op_FX33(const Instruction &);
+  void op_FX3A(const Instruction &);
+  template <uint32_t quirks> void op_FX55(const Instruction &);
+  template <uint32_t quirks> void op_FX65(const Instruction &);
+  void op_FX75(const Instruction &);
+  void op_FX85(const Instruction &);
 
 public:
-  Chip8(char *);
-  void run();
+  Chip8(const Rom &);
+  static Instruction split(uint16_t);
   void cycle();
+  void cycle_uncached();
   void update_timers();
-  void get_input();
+  uint32_t run_frame(uint32_t);
+  void predecode(const Rom_graph &);
+
+  EmuState get_state() const;
+  void set_state(EmuState);
+  void set_key(uint8_t, bool);
+  uint16_t get_keys() const;
+  void set_keys(uint16_t);
+  void seed(uint32_t);
+  uint64_t get_rom_hash() const;
+  bool sound_active() const;
+  const uint8_t *get_pattern() const; // 16 bytes
+  uint8_t get_pitch() const;
+  const config_t &get_config() const;
+  void set_config(const config_t &);
+  uint64_t get_cycle_count() const;
+  uint64_t get_frame_count() const;
+  uint64_t get_machine_cycles() const;
+  const Display &get_display() const;
+  Resolution get_resolution() const;
+  uint64_t display_hash() const;
+  void save_state(Snapshot &) const;
+  bool load_state(const Snapshot &);
+  uint64_t take_dirty_rows();
+  uint64_t get_display_version() const;
+  void set_profiler(Profiler *);
+  Profiler *get_profiler() const;
+  void set_debugger(Debugger *);
+  Debugger *get_debugger() const;
+  void set_tracer(Tracer *);
+
   ~Chip8();
 };
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "chip8.hpp"
+#include "debugger.hpp"
+#include <string>
+
+// Serves a Debugger over stdin/stdout, a local TCP port or a Unix socket,
+// one command per line and one reply line per command, in the spirit of
+// the GDB remote protocol without its framing and checksums:
+//
+//   ?                 why the machine is stopped (stop reply)
+//   g                 registers: v0..vf, i, pc, sp, dt, st
+//   mADDR,LEN         LEN bytes of memory from ADDR, as hex
+//   qStack            return addresses on the stack, innermost last
+//   Z0,ADDR / z0,ADDR set / clear a breakpoint
+//   Z2,ADDR,LEN       watch stores to LEN bytes from ADDR (z2 to clear)
+//   s / n / c         step, step over a call, continue
+//   0x03 byte         interrupt a running machine
+//   D                 detach: clear everything and let the machine run
+//   k                 kill: quit the machine
+//
+// Numbers are hex. Replies are OK, E01 for a bad command, an empty line
+// for an unknown one, or the data asked for. Stepping and continuing reply
+// when the machine stops again, with a stop reply: T05 plus swbreak:;
+// for a breakpoint or watch:ADDR; for a watchpoint, T02 for an interrupt,
+// T06 when the machine halted itself, each followed by pc:ADDR;. While
+// the machine runs only an interrupt is looked at; commands sent meanwhile
+// wait for the next stop.
+class Debug_server {
+private:
+  Chip8 &chip;
+  Debugger &debugger;
+  int listener; // listening socket, -1 for stdin or once connected
+  int input;    // -1 once detached
+  int output;
+  std::string pending; // input read but not yet a whole line
+  bool reported;       // the current stop was replied to
+
+  bool receive(bool wait);
+  bool read_line(std::string &);
+  void reply(const std::string &);
+  std::string stop_reply() const;
+  bool command(const std::string &);
+  void close_client();
+
+public:
+  Debug_server(Chip8 &, Debugger &);
+  // Where to serve: "-" for stdin/stdout, a port number for TCP on
+  // 127.0.0.1, anything else is a Unix socket path. Waits for the client
+  // to connect; the machine starts out stopped.
+  bool open(const char *);
+  // Call between frames. While the machine is stopped this reports the stop
+  // and serves commands until it is resumed; while it runs, it handles
+  // whatever came in without waiting. Returns false once the client has
+  // detached, quit or gone away.
+  bool serve();
+  ~Debug_server();
+
+  Debug_server(const Debug_server &) = delete;
+  Debug_server &operator=(const Debug_server &) = delete;
+};
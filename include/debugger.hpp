@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Why a debugged machine is stopped.
+enum Debug_stop {
+  DEBUG_RUNNING,    // not stopped
+  DEBUG_BREAKPOINT, // pc reached a breakpoint, before running it
+  DEBUG_WATCHPOINT, // an instruction stored to a watched address
+  DEBUG_STEP,       // a step or step-over finished
+  DEBUG_INTERRUPT,  // interrupt() was called
+  DEBUG_HALT,       // the machine stopped itself (stack over/underflow,
+                    // 00FD, pc off the end of memory)
+};
+
+enum Debug_step {
+  STEP_NONE,
+  STEP_INTO, // stop after one instruction
+  STEP_OVER, // same, but run a 2NNN call until it returns
+};
+
+// Breakpoints, watchpoints and stepping for one Chip8, attached with
+// set_debugger(). While nothing is armed the machine runs on its usual
+// backend with no per-instruction checks; once a breakpoint, watchpoint or
+// step is armed, frames run through Chip8::run_debug() instead, which
+// checks before and after every instruction. A stop can come in the middle
+// of a frame: the machine holds that frame, without ticking the timers,
+// and runs the rest of it when resumed.
+class Debugger {
+private:
+  std::vector<uint8_t> breakpoints; // per address, 1 if set
+  std::vector<uint8_t> watchpoints; // per address, 1 if stores are watched
+  uint32_t armed_points;            // addresses set in either
+  Debug_stop stop;
+  uint16_t stop_addr; // the watched address stored to
+  Debug_step stepping;
+  uint16_t step_pc;   // STEP_OVER: where the call returns to
+  uint8_t step_sp;    // and the stack depth it returns at
+  bool resuming;      // don't break again at the pc stopped at
+
+public:
+  Debugger();
+
+  void set_breakpoint(uint16_t, bool);
+  void set_watchpoint(uint16_t addr, uint16_t size, bool);
+  bool has_breakpoint(uint16_t) const;
+  void clear();
+
+  // Anything to check per instruction, or stopped
+  bool armed() const {
+    return this->armed_points > 0 || this->stepping != STEP_NONE ||
+           this->stop != DEBUG_RUNNING;
+  }
+  bool stopped() const { return this->stop != DEBUG_RUNNING; }
+  Debug_stop get_stop() const;
+  uint16_t get_stop_addr() const;
+
+  // Leave a stop. step_over needs the instruction at pc and the stack
+  // depth, to tell a call from anything else.
+  void resume();
+  void step();
+  void step_over(uint16_t pc, uint16_t inst, uint8_t sp);
+  void interrupt();
+  void halt();
+
+  // Hooks for Chip8::run_debug(). Each returns true if the machine has to
+  // stop now.
+  bool before(uint16_t pc) {
+    if (this->resuming) {
+      this->resuming = false;
+      return false;
+    }
+    if (this->breakpoints[pc]) {
+      this->stop = DEBUG_BREAKPOINT;
+      return true;
+    }
+    return false;
+  }
+  bool stored(uint16_t addr, uint32_t size);
+  bool after(uint16_t pc, uint8_t sp);
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "rom.hpp"
+#include "structs.hpp"
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// What analyze() found at a memory address.
+enum Byte_kind : uint8_t {
+  BYTE_DATA,    // never reached as code (sprites, tables, padding)
+  BYTE_CODE,    // first byte of an instruction
+  BYTE_OPERAND, // rest of an instruction, or XO-CHIP F000's address word
+};
+
+// How control leaves a basic block.
+enum Block_exit {
+  EXIT_FALL,     // into the next block
+  EXIT_JUMP,     // 1NNN
+  EXIT_CALL,     // 2NNN, returns to the next block
+  EXIT_RETURN,   // 00EE
+  EXIT_SKIP,     // skip instruction: next instruction or the one after
+  EXIT_INDIRECT, // BNNN, target depends on a register
+  EXIT_STOP,     // 00FD, or runs off the end of memory
+};
+
+// A straight-line run of code with one entry at start.
+typedef struct {
+  uint16_t start;
+  uint16_t end; // one past the last instruction byte
+  Block_exit exit;
+  std::vector<uint16_t> successors; // blocks control can go to next
+} Cfg_block;
+
+// Control-flow graph of a ROM, found by following every path from the
+// entry point.
+typedef struct {
+  Platform platform;
+  uint32_t size;                 // ROM bytes from 0x200
+  std::vector<Byte_kind> kinds;  // per address, 0x200 + size of them
+  std::map<uint16_t, Cfg_block> blocks; // by start
+  std::map<uint16_t, uint32_t> calls;   // 2NNN targets, call sites each
+  std::map<uint16_t, uint32_t> pointers; // ANNN targets in the ROM
+} Rom_graph;
+
+// Mnemonic and operands of inst as platform decodes it, e.g.
+// "LD V3, 0x1F". next is the word after it, for XO-CHIP's F000 NNNN.
+std::string disassemble(uint16_t inst, uint16_t next, Platform);
+
+// Bytes an instruction at pc occupies: 4 for XO-CHIP F000 NNNN, else 2.
+uint32_t instruction_size(uint16_t inst, Platform);
+
+// Recursively discovers the code reachable from 0x200. Jumps, calls and
+// both ways out of skips are followed. BNNN is followed to NNN and through
+// the jump table there, if NNN starts with 1NNN jumps, since V0 is
+// unknown.
+Rom_graph analyze(const Rom &, Platform);
+
+// Listing with labels: code as mnemonics, everything else as data bytes.
+void write_listing(std::ostream &, const Rom &, const Rom_graph &);
+
+// The graph in Graphviz DOT, one node per basic block.
+void write_dot(std::ostream &, const Rom &, const Rom_graph &);
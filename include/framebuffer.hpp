@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#define DISPLAY_WIDTH 128 // widest mode, SUPER-CHIP/XO-CHIP hires
+#define DISPLAY_HEIGHT 64
+#define DISPLAY_PLANES 2 // XO-CHIP bitplanes
+
+// Screen modes, each showing part of the framebuffer.
+enum Resolution {
+  RES_LORES, // 64x32
+  RES_TALL,  // 64x64, VIP two-page hires
+  RES_HIRES, // 128x64
+};
+
+// Packed framebuffer: display[plane][half][row] holds columns 0-63 (half 0)
+// or 64-127 (half 1) of a row, bit 63 = leftmost column. Modes 64 columns
+// wide only use half 0, so plain CHIP-8 lores is display[0][0][0..31].
+typedef uint64_t Display[DISPLAY_PLANES][2][DISPLAY_HEIGHT];
+
+inline uint32_t resolution_width(Resolution resolution) {
+  return resolution == RES_HIRES ? 128 : 64;
+}
+
+inline uint32_t resolution_height(Resolution resolution) {
+  return resolution == RES_LORES ? 32 : 64;
+}
+
+// Expands count rows of display starting at first into DISPLAY_WIDTH 32-bit
+// pixels per row, colored by palette[plane bits] (bit 0 = plane 0). Modes
+// narrower or shorter than 128x64 are scaled up to fill it, so the output
+// is always count * DISPLAY_HEIGHT / height rows. pixels points at the
+// first output row; rows are DISPLAY_WIDTH pixels apart.
+void expand_rows(const Display &display, Resolution resolution,
+                 uint32_t first, uint32_t count, const uint32_t palette[4],
+                 uint32_t *pixels);
+
+// FNV-1a over packed display rows, most significant byte first, continuing
+// from hash.
+uint64_t hash_rows(const uint64_t *rows, uint32_t count,
+                   uint64_t hash = 0xcbf29ce484222325ULL);
+
+// FNV-1a over the visible part of display. Plain 64x32 single plane
+// pictures hash the same as hash_rows() over their 32 rows.
+uint64_t hash_display(const Display &display, Resolution resolution);
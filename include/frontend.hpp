@@ -0,0 +1,67 @@
+#pragma once
+
+#include "audio.hpp"
+#include "chip8.hpp"
+#include "framebuffer.hpp"
+#include "movie.hpp"
+#include "rewind.hpp"
+#include "sdl.hpp"
+#include "triple_buffer.hpp"
+#include <atomic>
+#include <cstdint>
+
+// Requests from the window thread to the emulation thread
+#define FRONTEND_PAUSE 1 // toggle pause
+#define FRONTEND_TURBO 2 // toggle turbo
+#define FRONTEND_QUIT 4
+
+// A finished frame as the emulation thread publishes it.
+typedef struct {
+  Display display;
+  Resolution resolution;
+} Frontend_frame;
+
+// Windowed SDL frontend. The core runs and is paced on its own thread, which
+// is the only one touching the Chip8 while run() is going; the window thread
+// polls input and presents. Frames go to the window through a triple buffer,
+// keys and requests come back through atomics, so neither thread ever waits
+// for the other and a slow present can't stall emulation.
+class Frontend {
+private:
+  Chip8 &chip;
+  Audio_ring audio; // read by SDL's audio thread, so it outlives sdl
+  SDL_app sdl;
+  Rewind rewind;
+  Snapshot scratch;
+  Movie *movie; // recording input into, or nullptr
+  Audio_synth synth;
+
+  // Shared between the two threads
+  Triple_buffer<Frontend_frame> frames;
+  std::atomic<uint16_t> keys;      // bit n = key n down
+  std::atomic<bool> rewinding;     // BACKSPACE held
+  std::atomic<uint32_t> requests;  // FRONTEND_* not yet handled
+  std::atomic<bool> running;       // emulation thread still going
+
+  // Window thread only
+  bool needs_redraw; // window contents lost (expose/resize), present anyway
+  uint32_t palette[4];
+  Display shown; // what the window shows, to find the rows that changed
+  Resolution shown_resolution;
+
+  void emulate();
+  void handle_requests();
+  void run_frame();
+  void publish();
+
+  void present();
+  void set_key(uint8_t, bool);
+
+public:
+  Frontend(Chip8 &);
+  bool init();
+  void record(Movie *);
+  void run();
+  void get_input();
+  ~Frontend();
+};
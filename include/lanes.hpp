@@ -0,0 +1,85 @@
+#pragma once
+
+#include "chip8.hpp"
+#include "snapshot.hpp"
+#include "structs.hpp"
+#include <cstdint>
+
+#define MAX_LANES 32
+#define LANE_MEM_SIZE 4096
+// Each lane's memory is padded by a cache line so the same address in
+// different lanes doesn't map to the same L1 set.
+#define LANE_MEM_STRIDE (LANE_MEM_SIZE + 64)
+
+// Many machines stepped in lockstep, laid out as structure-of-arrays: every
+// register is an array with one entry per lane, so one SIMD instruction
+// (AVX2, SSE2, or a plain loop without either) updates it for every lane at
+// once. Meant for running one ROM under many seeds or inputs.
+//
+// Lanes never interact, so within a frame they don't have to move in step:
+// each has its own instruction budget, and each step runs the lanes at the
+// lowest pc while the rest wait. Lanes that have drifted apart thereby
+// tend to line up again (typically in the same wait loop). Lanes at the
+// same pc that fetch different opcodes (self-modified code) run one group
+// per opcode with the others masked off. Either way every lane executes
+// exactly what Chip8::run_frame() would. Memory, the framebuffer and the
+// stack are per lane and are handled one lane at a time. Frames are always
+// inst_per_frame instructions (TIMING_INSTRUCTIONS), no quirks apply and
+// the machine is a plain PLATFORM_CHIP8 one; supports() tells whether a
+// config is one of those. Made with any other, ok() is false and no lane
+// loads a state.
+class Chip8_lanes {
+private:
+  uint32_t lanes;
+  config_t config;
+  bool supported;
+  alignas(32) uint8_t gpr[16][MAX_LANES]; // gpr[x][lane]
+  alignas(32) uint8_t delay[MAX_LANES];
+  alignas(32) uint8_t sound[MAX_LANES];
+  alignas(32) uint8_t is_sound_active[MAX_LANES];
+  alignas(32) uint8_t sp[MAX_LANES];
+  alignas(32) uint16_t pc[MAX_LANES];
+  alignas(32) uint16_t i[MAX_LANES];
+  alignas(32) uint16_t stack[12][MAX_LANES];
+  alignas(32) uint16_t keys[MAX_LANES]; // bit n = key n down
+  alignas(32) uint32_t rng_state[MAX_LANES];
+  alignas(32) uint16_t fetched[MAX_LANES]; // opcodes of the current step
+  EmuState state[MAX_LANES];
+  alignas(32) uint16_t left[MAX_LANES]; // instructions left this frame
+  uint32_t running; // bit n = lane n is RUNNING
+  uint64_t cycle_count[MAX_LANES];
+  uint64_t frame_count[MAX_LANES];
+  // The code every lane started from, and for each 64 byte chunk of it the
+  // lanes whose memory no longer matches. Lanes at the same pc in matching
+  // chunks fetch the same opcode, so it is read once for all of them.
+  uint8_t shared[LANE_MEM_SIZE];
+  bool has_shared;
+  uint32_t shared_diff[LANE_MEM_SIZE / 64];
+  uint8_t mem[MAX_LANES][LANE_MEM_STRIDE];
+  uint64_t display[MAX_LANES][32];
+
+  void run_budget(uint16_t);
+  void run_at(uint16_t, uint32_t);
+  void execute(const Instruction &, uint32_t);
+  void write_mem(uint32_t, uint16_t, uint8_t);
+  void op_DXYN(uint32_t, const Instruction &);
+
+public:
+  static bool supports(const config_t &);
+
+  Chip8_lanes(uint32_t, const config_t &);
+  bool ok() const;
+  uint32_t size() const;
+  void run_frame(uint32_t);
+  void update_timers();
+
+  bool load_state(uint32_t, const Snapshot &);
+  void save_state(uint32_t, Snapshot &) const;
+  void seed(uint32_t, uint32_t);
+  void set_keys(uint32_t, uint16_t);
+  EmuState get_state(uint32_t) const;
+  void set_state(uint32_t, EmuState);
+  uint64_t get_cycle_count(uint32_t) const;
+  uint64_t get_frame_count(uint32_t) const;
+  uint64_t display_hash(uint32_t) const;
+};
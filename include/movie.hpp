@@ -0,0 +1,60 @@
+#pragma once
+
+#include "chip8.hpp"
+#include <cstdint>
+#include <vector>
+
+#define MOVIE_MAGIC 0x564D3843 // "C8MV" little endian
+#define MOVIE_VERSION 3
+
+// Everything besides input that a run depends on. Written at the start of
+// a movie file, followed by event_count events of 6 bytes each
+// (uint32_t frame, uint16_t keys), little endian. Older headers are
+// shorter: version 1 ends after event_count (TIMING_INSTRUCTIONS), version
+// 2 after cycles_per_frame (no quirks).
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t rom_hash;
+  uint32_t seed;
+  uint32_t inst_per_frame;
+  uint64_t frames; // length of the recording
+  uint64_t event_count;
+  uint32_t timing; // Timing
+  uint32_t cycles_per_frame;
+  uint32_t quirks;
+  uint32_t platform; // Platform, 0 (CHIP-8) in files from before it was kept
+} Movie_header;
+
+#define MOVIE_HEADER_V1_SIZE 40
+#define MOVIE_HEADER_V2_SIZE 48
+
+static_assert(sizeof(Movie_header) == 56, "Movie_header layout changed");
+
+// Keypad state from the start of frame on, until the next event.
+typedef struct {
+  uint32_t frame;
+  uint16_t keys; // bit n = key n down
+} Movie_event;
+
+// Input recording keyed by emulated frame. Only changes are stored, so a
+// movie is a few bytes per key press no matter how long it runs. Replaying
+// one from power-on with the same ROM and seed reproduces the run exactly.
+class Movie {
+private:
+  Movie_header header;
+  std::vector<Movie_event> events;
+  size_t cursor; // next event to play
+
+public:
+  Movie();
+  void start(Chip8 &, uint32_t);
+  void record(const Chip8 &);
+  void truncate(uint64_t);
+  void finish(const Chip8 &);
+  void play(Chip8 &);
+  bool keys_at(uint64_t, uint16_t &);
+  const Movie_header &get_header() const;
+  bool save(const char *) const;
+  bool load(const char *);
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+// Host time is split between these. Each is only ever timed from one
+// thread (the SDL frontend polls and presents on another than it emulates).
+enum Profile_section {
+  PROFILE_EXECUTE, // running instructions (cycle(), blocks)
+  PROFILE_TIMERS,  // update_timers()
+  PROFILE_INPUT,   // polling host input
+  PROFILE_PRESENT, // uploading and presenting the screen
+  PROFILE_SECTIONS
+};
+
+// One node of the call tree: the function entered at addr (2NNN target)
+// under parent, and the instructions run while it was the innermost call.
+typedef struct {
+  uint16_t addr;
+  uint32_t parent;
+  uint64_t count;
+} Profile_frame;
+
+// Where a ROM spends its time: executions per opcode and per pc, call
+// edges and a call tree from 2NNN/00EE, and host time per section. Attached
+// to a Chip8 with set_profiler(); the hooks that feed it are only compiled
+// in with CHIP8_PROFILE, so it costs nothing otherwise.
+class Profiler {
+private:
+  std::vector<uint64_t> opcode_counts; // indexed by opcode
+  std::vector<uint64_t> pc_counts;     // indexed by pc
+  std::unordered_map<uint32_t, uint64_t> call_edges; // site << 16 | target
+  std::vector<Profile_frame> frames; // call tree, frames[0] is the root
+  std::unordered_map<uint64_t, uint32_t> children; // parent << 16 | addr
+  uint32_t current; // frame of the innermost call
+  uint64_t idle_skipped; // instructions the recompiler skipped in idle loops
+  uint64_t section_ns[PROFILE_SECTIONS];
+
+public:
+  Profiler();
+
+  void instruction(uint16_t pc, uint16_t inst) {
+    this->opcode_counts[inst]++;
+    this->pc_counts[pc]++;
+    this->frames[this->current].count++;
+  }
+  void call(uint16_t, uint16_t);
+  void ret();
+  void lost_stack();
+  void skipped(uint64_t);
+  void add_time(Profile_section, uint64_t);
+
+  void write_json(std::ostream &) const;
+  void write_collapsed(std::ostream &) const;
+};
+
+// Writes <prefix>.json and <prefix>.folded
+bool save_profile(const char *prefix, const Profiler &);
+
+// Adds the time from construction to destruction to a section.
+class Profile_timer {
+private:
+  Profiler *profiler;
+  Profile_section section;
+  std::chrono::steady_clock::time_point start;
+
+public:
+  Profile_timer(Profiler *profiler, Profile_section section)
+      : profiler(profiler), section(section),
+        start(std::chrono::steady_clock::now()) {}
+  ~Profile_timer() {
+    if (this->profiler != nullptr) {
+      const auto elapsed = std::chrono::steady_clock::now() - this->start;
+      this->profiler->add_time(
+          this->section,
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+              .count());
+    }
+  }
+};
+
+// Hooks, all no-ops unless built with CHIP8_PROFILE. profiler may be null.
+#ifdef CHIP8_PROFILE
+#define PROFILE_HOOK(profiler, call)                                           \
+  do {                                                                         \
+    if (profiler) {                                                            \
+      (profiler)->call;                                                        \
+    }                                                                          \
+  } while (0)
+#define PROFILE_INSTRUCTION(profiler, pc, inst)                                \
+  PROFILE_HOOK(profiler, instruction(pc, inst))
+#define PROFILE_CALL(profiler, site, target)                                   \
+  PROFILE_HOOK(profiler, call(site, target))
+#define PROFILE_RETURN(profiler) PROFILE_HOOK(profiler, ret())
+#define PROFILE_LOST_STACK(profiler) PROFILE_HOOK(profiler, lost_stack())
+#define PROFILE_SKIPPED(profiler, count) PROFILE_HOOK(profiler, skipped(count))
+#define PROFILE_SCOPE(profiler, section)                                       \
+  Profile_timer profile_timer(profiler, section)
+#else
+#define PROFILE_INSTRUCTION(profiler, pc, inst)
+#define PROFILE_CALL(profiler, site, target)
+#define PROFILE_RETURN(profiler)
+#define PROFILE_LOST_STACK(profiler)
+#define PROFILE_SKIPPED(profiler, count)
+#define PROFILE_SCOPE(profiler, section)
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "structs.hpp"
+#include <cstdint>
+
+// Behaviours that differ between CHIP-8 interpreters. config.quirks is a
+// set of these; none set is this emulator's original behaviour.
+#define QUIRK_SHIFT_VY 0x01     // 8XY6/8XYE shift VY into VX, not VX itself
+#define QUIRK_LOAD_STORE_I 0x02 // FX55/FX65 leave I past the last register
+#define QUIRK_JUMP_VX 0x04      // BXNN jumps to XNN + VX, not NNN + V0
+#define QUIRK_VF_RESET 0x08     // 8XY1/8XY2/8XY3 clear VF
+#define QUIRK_DISPLAY_WAIT 0x10 // DXYN waits for the next frame
+#define QUIRK_WRAP 0x20         // sprites wrap around the screen edges
+#define QUIRK_ALL 0x3F
+
+// Named machines: a platform plus the quirks of its interpreter
+enum Profile {
+  PROFILE_DEFAULT,     // no quirks, what this emulator always did
+  PROFILE_CHIP8,       // the COSMAC VIP interpreter
+  PROFILE_CHIP8_HIRES, // the VIP with the two-page hires interpreter
+  PROFILE_SCHIP,       // CHIP-48 / SUPER-CHIP on the HP48
+  PROFILE_XOCHIP,      // Octo's XO-CHIP
+};
+
+uint32_t profile_quirks(Profile);
+Platform profile_platform(Profile);
+
+// Parses "default", "chip8", "chip8hires", "schip" or "xochip". Returns
+// false otherwise.
+bool parse_profile(const char *, Profile &);
+
+// The name parse_profile() takes for a profile.
+const char *profile_name(Profile);
+
+// The profile known ROMs need, by ROM hash (Chip8::get_rom_hash()).
+// Returns PROFILE_DEFAULT for ROMs not in the database.
+Profile rom_profile(uint64_t);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "snapshot.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One stored frame. A keyframe holds a whole Snapshot (snapshot_size()
+// bytes of it); any other frame holds the 8-byte words that differ from its
+// keyframe, XORed with it.
+typedef struct {
+  uint32_t offset; // into the arena
+  uint32_t size;   // bytes
+  uint64_t key;    // sequence number of the keyframe, == own one for keys
+} Rewind_entry;
+
+// Fixed-size history of per-frame snapshots for stepping backwards.
+// Everything is allocated up front: a ring of entries (one per frame) and a
+// byte arena the encoded frames are written into. When either is full the
+// oldest frames are dropped, so memory use never grows.
+class Rewind {
+private:
+  std::vector<Rewind_entry> entries;
+  std::vector<uint8_t> arena;
+  uint64_t oldest; // sequence number of the oldest stored frame
+  uint64_t next;   // sequence number the next pushed frame gets
+  uint32_t head;   // arena offset the next frame is written at
+  uint32_t keyframe_interval;
+  Snapshot key;       // decoded copy of keyframe key_seq
+  uint64_t key_seq;   // UINT64_MAX when key holds nothing
+
+  Rewind_entry &entry(uint64_t);
+  void drop_oldest();
+  uint32_t reserve(uint32_t);
+  bool load_key(uint64_t);
+
+public:
+  Rewind(uint32_t, uint32_t, size_t);
+  void push(const Snapshot &);
+  bool pop(Snapshot &);
+  uint32_t size() const;
+  void clear();
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "quirks.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define ROM_ENTRY_POINT 0x200
+#define ROM_MAX_SIZE (0x10000 - ROM_ENTRY_POINT) // all of XO-CHIP's memory
+
+// A ROM image, read-only, with its FNV-1a hash.
+typedef struct {
+  const uint8_t *data;
+  uint32_t size;
+  uint64_t hash;
+} Rom;
+
+// FNV-1a over a ROM image, the hash ROMs are known by (movies, quirks).
+uint64_t rom_hash(const uint8_t *, uint32_t);
+
+// A ROM file mapped read-only, memory-mapped where available.
+class Rom_file {
+private:
+  Rom rom;
+  const char *error; // nullptr once loaded
+  void *mapping;
+  size_t mapped_size;
+
+public:
+  Rom_file(const char *);
+  const Rom *get() const;      // nullptr if the file couldn't be loaded
+  const char *why_not() const; // what went wrong, for messages
+
+  ~Rom_file();
+
+  Rom_file(const Rom_file &) = delete;
+  Rom_file &operator=(const Rom_file &) = delete;
+};
+
+// A catalog entry: where a ROM is and what it runs on.
+typedef struct {
+  uint64_t hash;
+  uint32_t size;
+  Profile profile; // from the quirks database, PROFILE_DEFAULT if unknown
+  std::string path;
+} Rom_entry;
+
+// ROMs mapped once and shared read-only by any number of machines and
+// threads, by path and by content hash. After a ROM's first load, loading
+// it again is a table lookup. Everything stays mapped until the library
+// goes away.
+class Rom_library {
+private:
+  mutable std::mutex lock;
+  std::unordered_map<std::string, std::unique_ptr<Rom_file>> files;
+  std::unordered_map<uint64_t, Rom_entry> catalog;
+
+  const Rom *load_locked(const std::string &, const char **);
+
+public:
+  // The ROM at path, mapping it on first use. nullptr and the reason in
+  // error if it can't be loaded.
+  const Rom *load(const std::string &, const char **error = nullptr);
+  // Maps every .ch8 under a directory, recursively, into the catalog.
+  // Returns how many were added.
+  uint32_t scan(const std::string &);
+  // A cataloged ROM by content hash, nullptr if there is none.
+  const Rom *find(uint64_t);
+  std::vector<Rom_entry> entries() const; // sorted by path
+};
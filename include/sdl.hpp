@@ -1,33 +1,34 @@
 #pragma once
 
-#include "structs.hpp"
+#include "audio.hpp"
+#include "framebuffer.hpp"
+#include "SDL3/SDL_render.h"
+#include "SDL3/SDL_video.h"
 #include <SDL3/SDL.h>
-#include <atomic>
+#include <cstdint>
 
-#define AMPLITUDE 0.25f
-#define BEEP_FREQUENCY 350.0f
-#define SAMPLE_RATE 8000
+typedef struct {
+  SDL_Window *window;
+  SDL_Renderer *renderer;
+  SDL_Texture *texture; // framebuffer at 128x64, scaled on present
+} SDL_t;
 
 class SDL_app {
 private:
   SDL_t state{};
+  uint32_t pixels[DISPLAY_HEIGHT * DISPLAY_WIDTH]{}; // CPU copy of the texture
 
   SDL_AudioStream *audio_stream = nullptr;
-  std::atomic<bool> s_should_beep_play{false};
-  int wave_sample = 0;
-
-  void generate_beep();
 
 public:
   SDL_app() = default;
 
   SDL_AppResult init(uint32_t, uint32_t, uint32_t);
-  bool platform_init_audio();
-  void platform_start_beep();
-  void platform_stop_beep();
+  bool init_audio(Audio_ring &);
 
   void clear_screen(uint32_t);
-  void update_screen(uint32_t, uint32_t, uint32_t, bool[32][64]);
+  void update_screen(const uint32_t[4], const Display &, Resolution,
+                     uint64_t);
 
   ~SDL_app();
 };
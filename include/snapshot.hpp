@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define SNAPSHOT_MAGIC 0x38504843 // "CHP8" little endian
+#define SNAPSHOT_VERSION 4
+
+// Complete machine state in a fixed little-endian layout with no pointers,
+// so it can be copied with memcpy, written to disk as is and mapped back in.
+// Memory comes last and only its first mem_size bytes are used (4 KB but on
+// XO-CHIP), so snapshot_size() bytes are all there is to copy, store or
+// compare.
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t platform;          // Platform, which a snapshot only loads into
+  uint32_t mem_size;          // bytes of mem in use
+  uint64_t display[2][2][64]; // see Display in framebuffer.hpp
+  uint16_t stack[16];
+  uint16_t pc;
+  uint16_t i;
+  uint8_t gpr[16];
+  uint8_t sp;
+  uint8_t delay;
+  uint8_t sound;
+  uint8_t state;
+  uint16_t keypad; // bit n = key n down
+  uint8_t is_sound_active;
+  uint8_t resolution; // Resolution
+  uint32_t rng_state;
+  uint64_t cycle_count;
+  uint64_t frame_count;
+  uint64_t machine_cycles; // emulated cost under TIMING_VIP
+  uint32_t cycle_debt;     // cycles the last frame overran into the next
+  uint8_t planes;          // XO-CHIP planes drawn to
+  uint8_t pitch;           // XO-CHIP audio pattern rate
+  uint8_t reserved[2];
+  uint8_t rpl[16];      // SUPER-CHIP/XO-CHIP flag registers
+  uint8_t pattern[16];  // XO-CHIP audio pattern
+  uint8_t mem[0x10000]; // all of XO-CHIP's, the rest use 4 KB of it
+} Snapshot;
+
+static_assert(sizeof(Snapshot) == 67728, "Snapshot layout changed");
+static_assert(offsetof(Snapshot, mem) % 8 == 0,
+              "Snapshot sizes must be whole words");
+
+// Bytes of snapshot in use: everything up to mem, and mem_size of that.
+size_t snapshot_size(const Snapshot &);
+
+// FNV-1a over snapshot_size() bytes, to compare machine states.
+uint64_t snapshot_hash(const Snapshot &);
+
+// Writes snapshot_size() bytes of a snapshot to disk in its in-memory form.
+bool save_snapshot_file(const char *, const Snapshot &);
+
+// Read-only view of a snapshot file, memory-mapped where available. Only
+// snapshot_size() bytes of it are there to read.
+class Snapshot_file {
+private:
+  const Snapshot *snapshot;
+  size_t mapped_size;
+
+public:
+  Snapshot_file(const char *);
+  const Snapshot *get() const; // nullptr if the file couldn't be mapped
+  ~Snapshot_file();
+
+  Snapshot_file(const Snapshot_file &) = delete;
+  Snapshot_file &operator=(const Snapshot_file &) = delete;
+};
@@ -1,20 +1,42 @@
 #pragma once
-#include "SDL3/SDL_render.h"
-#include "SDL3/SDL_video.h"
 #include <cstdint>
 
-typedef struct {
-  SDL_Window *window;
-  SDL_Renderer *renderer;
-} SDL_t;
+// Which execution engine run_frame() uses.
+enum Backend {
+  BACKEND_UNCACHED,   // fetch + decode every instruction (reference)
+  BACKEND_CACHED,     // per-pc decode cache
+  BACKEND_RECOMPILER, // cached straight-line blocks
+};
+
+// What run_frame() budgets a frame by.
+enum Timing {
+  TIMING_INSTRUCTIONS, // inst_per_frame instructions, all the same cost
+  TIMING_VIP,          // cycles_per_frame COSMAC VIP machine cycles
+};
+
+// Which machine's instruction set and display the core emulates.
+enum Platform {
+  PLATFORM_CHIP8,       // COSMAC VIP CHIP-8: 64x32, 4 KB
+  PLATFORM_CHIP8_HIRES, // VIP two-page hires CHIP-8: adds 64x64 (1260, 0230)
+  PLATFORM_SCHIP,       // SUPER-CHIP 1.1: adds 128x64, scrolling, big font
+  PLATFORM_XOCHIP,      // XO-CHIP: adds 64 KB, two planes, audio patterns
+};
 
 typedef struct {
-  uint32_t width;
+  uint32_t width; // lores screen size; DXYN clips sprites to it
   uint32_t height;
   uint32_t fg_color;
   uint32_t bg_color;
+  uint32_t plane2_color;  // XO-CHIP pixels set only in the second plane
+  uint32_t overlap_color; // XO-CHIP pixels set in both planes
   uint32_t scaling_factor;
-  int inst_per_sec;
+  uint32_t inst_per_frame; // instructions executed per 60Hz frame
+  bool turbo;              // run frames back to back, no wall-clock pacing
+  Backend backend;
+  Timing timing;
+  uint32_t cycles_per_frame; // machine cycles per 60Hz frame with TIMING_VIP
+  uint32_t quirks;           // QUIRK_* flags, see quirks.hpp
+  Platform platform;
 } config_t;
 
 typedef struct {
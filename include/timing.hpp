@@ -0,0 +1,17 @@
+#pragma once
+
+#include "structs.hpp"
+#include <cstdint>
+
+// The COSMAC VIP's 1802 runs at 1.7609 MHz and takes 8 clocks per machine
+// cycle: about 3668 machine cycles per 60Hz frame. Video DMA (8 bytes for
+// each of 128 scanlines) and the display interrupt routine take about 1122
+// of them, which leaves the rest to the interpreter.
+#define VIP_CYCLES_PER_FRAME (3668 - 1122)
+
+// The interpreter's fetch/decode/dispatch loop, paid by every instruction
+#define VIP_FETCH_CYCLES 40
+
+// Approximate machine cycles the VIP interpreter spends on op, fetch
+// included, not counting DXYN's wait for the display.
+uint32_t vip_cycles(const Instruction &);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "structs.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+class Chip8;
+
+#define TRACE_MAGIC 0x52543843 // "C8TR" little endian
+#define TRACE_VERSION 1
+#define TRACE_RING_RECORDS (1 << 20) // 8 MB, a power of two
+
+// Trace_record.reg: which register the instruction changed
+#define TRACE_REG_I 0x10    // 0x0-0xF are V0-VF
+#define TRACE_REG_NONE 0x1F // nothing in V0-VF or I changed
+#define TRACE_REG_MASK 0x1F
+#define TRACE_MORE 0x80     // and more besides, only the first is recorded
+#define TRACE_FRAME 0x7F    // not an instruction: a frame just ended
+
+// What a trace file starts with.
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t rom_hash;
+  uint32_t platform; // Platform
+  uint32_t quirks;
+} Trace_header;
+
+// One executed instruction: where it was, what it was and the first
+// register it changed (V0-VF, then I) with its new value. A TRACE_FRAME
+// record marks the end of a frame instead, with the number of frames run
+// so far in pc (low 16 bits), inst and value (high 16 bits).
+typedef struct {
+  uint16_t pc;
+  uint16_t inst;
+  uint16_t value;
+  uint8_t reg; // TRACE_REG_* or a V register, maybe | TRACE_MORE
+  uint8_t sp;  // stack depth after the instruction
+} Trace_record;
+
+static_assert(sizeof(Trace_header) == 24, "Trace_header layout changed");
+static_assert(sizeof(Trace_record) == 8, "Trace_record layout changed");
+
+// Records every instruction a Chip8 runs into a preallocated ring, which a
+// writer thread drains to a file, so tracing costs the emulation thread a
+// store per instruction and no I/O. Attached with set_tracer(); the machine
+// then runs its frames instruction by instruction through run_debug(),
+// and costs nothing extra with no tracer attached. The ring never drops
+// records: if the writer falls a whole ring behind, the emulation thread
+// waits for it.
+class Tracer {
+private:
+  std::vector<Trace_record> ring;
+  uint32_t mask;
+  uint32_t unpublished; // producer's head, ahead of head until publish()
+  uint32_t free_until;  // producer's last look at tail + capacity
+  alignas(64) std::atomic<uint32_t> head; // next write, producer owned
+  alignas(64) std::atomic<uint32_t> tail; // next read, writer owned
+  std::atomic<bool> stopping;
+  std::atomic<bool> failed; // a write to the file went wrong
+  std::FILE *file;
+  std::thread writer;
+
+  void make_room();
+  void drain();
+
+public:
+  // Opens path and writes the header for chip's ROM and machine. ok()
+  // tells whether that worked; nothing is recorded if not.
+  Tracer(const char *path, const Chip8 &);
+  bool ok() const;
+
+  void record(uint16_t pc, uint16_t inst, uint8_t reg, uint16_t value,
+              uint8_t sp) {
+    if (this->unpublished == this->free_until) {
+      this->make_room();
+    }
+    this->ring[this->unpublished & this->mask] = {pc, inst, value, reg, sp};
+    this->unpublished++;
+  }
+  // Marks the end of a frame and hands what was recorded to the writer.
+  void frame(uint64_t);
+  void publish();
+  // Writes out everything recorded and closes the file. False if any of
+  // it couldn't be written.
+  bool finish();
+  ~Tracer();
+
+  Tracer(const Tracer &) = delete;
+  Tracer &operator=(const Tracer &) = delete;
+};
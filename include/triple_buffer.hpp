@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#define TRIPLE_BUFFER_FRESH 4 // middle holds a slot the reader hasn't seen
+
+// Lock-free handoff of the latest value from one writer thread to one
+// reader thread. The writer fills its back slot and publishes it, the
+// reader takes the newest published slot; neither ever waits for the
+// other. Values published while the reader was busy are dropped, only the
+// newest one is seen.
+template <typename T> class Triple_buffer {
+private:
+  struct alignas(64) Slot {
+    T value;
+  };
+
+  Slot slots[3];
+  std::atomic<uint8_t> middle; // slot index, | TRIPLE_BUFFER_FRESH
+  uint8_t back;                // writer's slot
+  uint8_t front;               // reader's slot
+
+public:
+  Triple_buffer() : middle(1), back(0), front(2) {}
+
+  // Writer: the slot to fill next. Its old contents are some earlier value.
+  T &write_slot() { return this->slots[this->back].value; }
+
+  // Writer: hands the filled slot over and takes the middle one back.
+  void publish() {
+    const uint8_t old = this->middle.exchange(
+        this->back | TRIPLE_BUFFER_FRESH, std::memory_order_acq_rel);
+    this->back = old & 3;
+  }
+
+  // Reader: swaps in the newest published value, false if there is none
+  // since the last call.
+  bool update() {
+    if (!(this->middle.load(std::memory_order_relaxed) &
+          TRIPLE_BUFFER_FRESH)) {
+      return false;
+    }
+    const uint8_t old =
+        this->middle.exchange(this->front, std::memory_order_acq_rel);
+    this->front = old & 3;
+    return true;
+  }
+
+  // Reader: the value last swapped in by update().
+  const T &read_slot() const { return this->slots[this->front].value; }
+
+  Triple_buffer(const Triple_buffer &) = delete;
+  Triple_buffer &operator=(const Triple_buffer &) = delete;
+};
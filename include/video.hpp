@@ -0,0 +1,98 @@
+#pragma once
+
+#include "framebuffer.hpp"
+#include "structs.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+class Chip8;
+
+#define VIDEO_QUEUE_PICTURES 256 // 512 KB of packed displays, a power of two
+#define VIDEO_MAX_SCALE 16
+
+enum Video_format {
+  VIDEO_GIF, // animated GIF, the 4 display colors, delays in 1/100 s
+  VIDEO_Y4M, // raw YUV 4:2:0 at 60 frames per second, to pipe to an encoder
+};
+
+// A picture and for how many 60Hz frames it stayed on screen.
+typedef struct {
+  Display display;
+  Resolution resolution;
+  uint32_t frames;
+} Video_picture;
+
+// Writes what a Chip8 shows, one call per emulated frame, as an animated GIF
+// or a Y4M stream, 128x64 times an integer scale (modes with fewer pixels
+// are scaled up to fill it, as on screen). A frame that shows the same as
+// the one before only makes the last picture last longer: a longer GIF
+// delay, or the same Y4M frame written out again without converting it
+// again. Pictures go through a bounded queue to a writer thread that
+// scales, converts and encodes them, so the emulation thread copies 2 KB
+// when the picture changes and nothing otherwise. What happens when the
+// writer falls a whole queue behind is up to the caller: wait for room, so
+// every picture is written (a machine running faster than real time
+// outruns any encoder), or with drop never wait, and hold a new picture
+// back instead, the one before staying on screen until there is room.
+class Video_writer {
+private:
+  std::vector<Video_picture> queue;
+  uint32_t mask;
+  Video_picture pending; // the producer's current picture, not queued yet
+  bool has_pending;
+  uint64_t pending_version; // display version pending was taken at
+  bool drop;        // never wait for room in the queue
+  uint64_t dropped; // frames that showed an earlier picture because of it
+  alignas(64) std::atomic<uint32_t> head; // next write, producer owned
+  alignas(64) std::atomic<uint32_t> tail; // next read, writer owned
+  std::atomic<bool> stopping;
+  std::atomic<bool> failed; // a write to the file went wrong
+  Video_format format;
+  uint32_t scale;
+  uint32_t width; // output size in pixels
+  uint32_t height;
+  uint32_t palette[4]; // RGBA, indexed by plane bits
+  std::FILE *file;
+  std::thread writer;
+
+  // Writer thread state
+  std::vector<uint32_t> expanded; // 128x64 palette indices
+  std::vector<uint8_t> pixels;    // indices at the output size
+  std::vector<uint8_t> previous;  // GIF: the picture before, to diff with
+  std::vector<uint8_t> encoded;   // GIF: LZW data, Y4M: a converted frame
+  uint64_t written_frames;        // GIF: 60Hz frames shown so far
+  bool has_previous;
+
+  bool push();
+  void drain();
+  void write(const void *, size_t);
+  void write_header();
+  void write_picture(const Video_picture &);
+  void write_gif(uint32_t frames);
+  void write_y4m(uint32_t frames);
+
+public:
+  // Opens path ("-" is stdout) and writes the header for a stream colored
+  // by config's palette. ok() tells whether that worked.
+  Video_writer(const char *path, Video_format, uint32_t scale,
+               const config_t &, bool drop);
+  bool ok() const;
+
+  // The display after a frame; call once per emulated frame.
+  void frame(const Chip8 &);
+  // Writes out everything queued and closes the file. False if any of it
+  // couldn't be written.
+  bool finish();
+  uint64_t get_dropped() const; // always 0 without drop
+  ~Video_writer();
+
+  Video_writer(const Video_writer &) = delete;
+  Video_writer &operator=(const Video_writer &) = delete;
+};
+
+// The format for a file name: VIDEO_GIF for .gif, VIDEO_Y4M for .y4m and
+// "-". False for anything else.
+bool video_format(const char *, Video_format &);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// Fixed set of worker threads for running many independent jobs. Each
+// worker starts with its own contiguous share of the jobs and takes from
+// the front of it; a worker that runs dry steals from the back of another
+// worker's share, so a few slow jobs don't leave the other cores idle.
+class Work_pool {
+private:
+  struct Queue {
+    std::mutex lock;
+    std::deque<size_t> jobs;
+  };
+
+  uint32_t threads;
+  std::unique_ptr<Queue[]> queues;
+
+  bool take(uint32_t, size_t &);
+
+public:
+  Work_pool(uint32_t);
+  uint32_t size() const;
+  // Calls job(index, worker) once for every index below count and returns
+  // when all have finished.
+  void run(size_t, const std::function<void(size_t, uint32_t)> &);
+};
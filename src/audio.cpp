@@ -0,0 +1,90 @@
+#include "audio.hpp"
+#include "chip8.hpp"
+#include <cmath>
+#include <cstdint>
+
+Audio_ring::Audio_ring(uint32_t capacity)
+    : samples(capacity), mask(capacity - 1), head(0), tail(0) {}
+
+uint32_t Audio_ring::write(const float *data, uint32_t count) {
+  const uint32_t head = this->head.load(std::memory_order_relaxed);
+  const uint32_t tail = this->tail.load(std::memory_order_acquire);
+  const uint32_t space = (uint32_t)this->samples.size() - (head - tail);
+  if (count > space) {
+    count = space;
+  }
+  for (uint32_t n = 0; n < count; n++) {
+    this->samples[(head + n) & this->mask] = data[n];
+  }
+  this->head.store(head + count, std::memory_order_release);
+  return count;
+}
+
+uint32_t Audio_ring::read(float *data, uint32_t count) {
+  const uint32_t tail = this->tail.load(std::memory_order_relaxed);
+  const uint32_t head = this->head.load(std::memory_order_acquire);
+  if (count > head - tail) {
+    count = head - tail;
+  }
+  for (uint32_t n = 0; n < count; n++) {
+    data[n] = this->samples[(tail + n) & this->mask];
+  }
+  this->tail.store(tail + count, std::memory_order_release);
+  return count;
+}
+
+uint32_t Audio_ring::size() const {
+  return this->head.load(std::memory_order_acquire) -
+         this->tail.load(std::memory_order_acquire);
+}
+
+// Phase step per sample for a wave repeating frequency times a second
+static uint32_t phase_step(double frequency) {
+  return (uint32_t)(frequency * 4294967296.0 / AUDIO_SAMPLE_RATE);
+}
+
+static_assert(AUDIO_TABLE_SIZE == 256, "beep lookup uses the top 8 bits");
+
+Audio_synth::Audio_synth() : phase(0) {
+  for (uint32_t n = 0; n < AUDIO_TABLE_SIZE; n++) {
+    this->beep[n] = n < AUDIO_TABLE_SIZE / 2 ? AUDIO_AMPLITUDE
+                                              : -AUDIO_AMPLITUDE;
+  }
+  this->beep_step = phase_step(AUDIO_BEEP_FREQUENCY);
+  // XO-CHIP plays pattern bits at 4000 * 2^((pitch - 64) / 48) per second,
+  // all 128 of them per pass
+  for (uint32_t pitch = 0; pitch < 256; pitch++) {
+    const double bit_rate = 4000.0 * std::pow(2.0, (pitch - 64.0) / 48.0);
+    this->pattern_step[pitch] = phase_step(bit_rate / 128);
+  }
+}
+
+void Audio_synth::render_frame(const Chip8 &chip, Audio_ring &ring) {
+  if (!chip.sound_active()) {
+    return;
+  }
+  float samples[AUDIO_FRAME_SAMPLES];
+  const uint8_t *pattern = chip.get_pattern();
+  bool use_pattern = false;
+  if (chip.get_config().platform == PLATFORM_XOCHIP) {
+    for (uint32_t byte = 0; byte < 16; byte++) {
+      use_pattern |= pattern[byte] != 0;
+    }
+  }
+
+  if (use_pattern) {
+    const uint32_t step = this->pattern_step[chip.get_pitch()];
+    for (uint32_t n = 0; n < AUDIO_FRAME_SAMPLES; n++) {
+      const uint32_t bit = this->phase >> 25; // 0-127
+      const bool high = (pattern[bit >> 3] >> (7 - (bit & 7))) & 1;
+      samples[n] = high ? AUDIO_AMPLITUDE : -AUDIO_AMPLITUDE;
+      this->phase += step;
+    }
+  } else {
+    for (uint32_t n = 0; n < AUDIO_FRAME_SAMPLES; n++) {
+      samples[n] = this->beep[this->phase >> 24];
+      this->phase += this->beep_step;
+    }
+  }
+  ring.write(samples, AUDIO_FRAME_SAMPLES);
+}
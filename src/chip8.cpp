@@ -1,35 +1,40 @@
 #include "chip8.hpp"
-#include "SDL3/SDL_events.h"
-#include "SDL3/SDL_init.h"
-#include "SDL3/SDL_scancode.h"
-#include "SDL3/SDL_timer.h"
-#include "sdl.hpp"
+#include "framebuffer.hpp"
+#include "quirks.hpp"
+#include "timing.hpp"
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
-#include <fstream>
-#include <iostream>
 
-Chip8::Chip8(char *rom_path) {
+static_assert(ROM_ENTRY_POINT + ROM_MAX_SIZE == MEM_SIZE,
+              "ROMs may fill all of memory");
+
+// Powers on with rom loaded at 0x200. rom is copied, the caller keeps it.
+Chip8::Chip8(const Rom &rom) {
   this->config = {
       .width = 64,
       .height = 32,
       .fg_color = 0xFFFFFFFF,
       .bg_color = 0x000000FF,
+      .plane2_color = 0xAAAAAAFF,
+      .overlap_color = 0x555555FF,
       .scaling_factor = 20,
-      .inst_per_sec = 700,
+      .inst_per_frame = 12,
+      .turbo = false,
+      .backend = BACKEND_CACHED,
+      .timing = TIMING_INSTRUCTIONS,
+      .cycles_per_frame = VIP_CYCLES_PER_FRAME,
+      .quirks = 0,
+      .platform = PLATFORM_CHIP8,
   };
+  this->decoder = decoder_for(this->config.platform, this->config.quirks);
+  this->mem_size = 4096;
+  this->stack_size = 12;
+  this->vblank_wait = false;
 
-  // this->sdl = SDL_app();
-
-  if (this->sdl.init(this->config.width, this->config.height,
-                     this->config.scaling_factor) == SDL_APP_FAILURE) {
-    std::cerr << "Failed to initialize SDL" << std::endl;
-    exit(1);
-  }
-
-  uint16_t entry_point = 0x200;
+  uint16_t entry_point = ROM_ENTRY_POINT;
   memset(this->mem, 0, sizeof(mem));
 
   uint8_t font[80] = {
@@ -53,511 +58,326 @@ Chip8::Chip8(char *rom_path) {
   memcpy(this->mem + 0x050, font, sizeof(font));
 
   this->pc = entry_point;
-  this->stp = &(this->stack[0]);
-
-  std::ifstream rom(rom_path, std::ios::binary | std::ios::ate);
-  auto file_size = rom.tellg();
-  rom.seekg(0);
+  this->sp = 0;
+  memset(this->stack, 0, sizeof(this->stack));
 
-  if (file_size <= 0) {
-    std::cerr << "Rom of 0KB" << std::endl;
-    exit(1);
-  }
-  const long max_rom_size = sizeof(this->mem) - entry_point;
-
-  if (file_size > max_rom_size) {
-    std::cerr << "Rom too big: " << file_size << std::endl;
-    exit(1);
-  }
-  rom.read(reinterpret_cast<char *>(this->mem + entry_point), max_rom_size);
-
-  rom.close();
+  // Anything up to 64 KB loads; platforms with less memory just can't
+  // reach past their 4 KB
+  memcpy(this->mem + entry_point, rom.data,
+         std::min<uint32_t>(rom.size, ROM_MAX_SIZE));
+  this->rom_hash = rom.hash;
 
   this->sound = 0;
   this->delay = 0;
   this->is_sound_active = false;
 
   memset(this->gpr, 0, sizeof(this->gpr));
-
-  std::srand(std::time(NULL));
+  memset(this->rpl, 0, sizeof(this->rpl));
+  memset(this->pattern, 0, sizeof(this->pattern));
+  this->pitch = 64; // 4000Hz
+  memset(this->display, 0, sizeof(this->display));
+  this->resolution = RES_LORES;
+  this->planes = 1;
+  this->frame_dirty = 0;
+  this->dirty_rows = ~0ULL;
+  this->display_version = 0;
+  memset(this->decoded, 0, sizeof(this->decoded));
+  this->flush_blocks();
+  memset(this->keypad, false, sizeof(this->keypad));
+  this->i = 0;
+  this->cycle_count = 0;
+  this->frame_count = 0;
+  this->machine_cycles = 0;
+  this->cycle_debt = 0;
+  this->profiler = nullptr;
+  this->debugger = nullptr;
+  this->tracer = nullptr;
+  this->frame_spent = 0;
+  this->frame_held = false;
+
+  this->seed((uint32_t)std::time(NULL));
 
   this->state = EmuState::RUNNING;
 }
 
+// Hot path: executes the instruction at pc through the decode cache. Only
+// the first visit to an address fetches and decodes; after that it is a
+// table lookup and an indirect call.
 void Chip8::cycle() {
-  this->opcode.inst = (this->mem[this->pc] << 8) | (this->mem[this->pc + 1]);
+  if ((size_t)this->pc + 1 >= this->mem_size) {
+    this->state = EmuState::PAUSED;
+    return;
+  }
+
+  Decoded &entry = this->decoded[this->pc];
+  if (entry.handler == nullptr) {
+    entry.op = split((this->mem[this->pc] << 8) | (this->mem[this->pc + 1]));
+    entry.handler = this->decoder(entry.op.inst);
+  }
+  PROFILE_INSTRUCTION(this->profiler, this->pc, entry.op.inst);
   this->pc += 2;
+  this->cycle_count++;
 
-  // std::cout << std::hex << std::uppercase << this->opcode.inst << std::endl;
-
-  this->opcode.nnn = this->opcode.inst & 0x0FFF;
-  this->opcode.nn = this->opcode.inst & 0x00FF;
-  this->opcode.n = this->opcode.inst & 0x000F;
-  this->opcode.x = (this->opcode.inst & 0x0F00) >> 8;
-  this->opcode.y = (this->opcode.inst & 0x00F0) >> 4;
-
-  switch ((this->opcode.inst >> 12) & 0x0F) {
-  case 0x00:
-    switch (this->opcode.nn) {
-    case 0xE0:
-      memset(this->display, false, sizeof(this->display));
-      break;
-    case 0xEE:
-      if (this->stp > this->stack) {
-        this->stp--;
-        this->pc = *(this->stp);
-      } else {
-        this->state = EmuState::PAUSED;
-      }
-      break;
-    default:
-      // No op
-      break;
-    }
-    break;
-  case 0x01:
-    this->pc = this->opcode.nnn;
-    break;
+  entry.handler(*this, entry.op);
+}
 
-  case 0x02:
-    if (this->stp <
-        &this->stack[(sizeof(this->stack) / sizeof(this->stack[0])) - 1]) {
-      *this->stp = this->pc;
-      this->stp++;
-      this->pc = this->opcode.nnn;
-    } else {
-      this->state = EmuState::PAUSED;
-    }
-    break;
-  case 0x03:
-    if (this->gpr[this->opcode.x] == this->opcode.nn) {
-      this->pc += 2;
-    }
-    break;
-  case 0x04:
-    if (this->gpr[this->opcode.x] != this->opcode.nn) {
-      this->pc += 2;
-    }
-    break;
-  case 0x05:
-    if (this->gpr[this->opcode.x] == this->gpr[this->opcode.y]) {
-      this->pc += 2;
-    }
-    break;
-  case 0x06:
-    this->gpr[this->opcode.x] = this->opcode.nn;
-    break;
-  case 0x07:
-    this->gpr[this->opcode.x] += this->opcode.nn;
-    break;
-  case 0x08:
-    switch (this->opcode.n) {
-    case 0x0:
-      this->gpr[this->opcode.x] = this->gpr[opcode.y];
-      break;
-    case 0x1:
-      this->gpr[this->opcode.x] |= this->gpr[this->opcode.y];
-      break;
-    case 0x2:
-      this->gpr[this->opcode.x] &= this->gpr[this->opcode.y];
-      break;
-    case 0x3:
-      this->gpr[this->opcode.x] ^= this->gpr[this->opcode.y];
-      break;
-    case 0x4: {
-      uint16_t sum =
-          (uint16_t)this->gpr[this->opcode.x] + this->gpr[this->opcode.y];
-      this->gpr[this->opcode.x] = (uint8_t)sum;
-      if (sum > 0xFF) {
-        this->gpr[0xF] = 1;
-      } else {
-        this->gpr[0xF] = 0;
-      }
-      break;
-    }
-    case 0x5: {
-      if (this->gpr[this->opcode.y] > this->gpr[this->opcode.x]) {
-        this->gpr[0xF] = 0;
-      } else {
-        this->gpr[0xF] = 1;
-      }
-      this->gpr[this->opcode.x] =
-          this->gpr[this->opcode.x] - this->gpr[this->opcode.y];
-    }
-    case 0x6: {
-      this->gpr[0xF] = this->gpr[this->opcode.x] & 0x01;
-      this->gpr[this->opcode.x] >>= 1;
-      break;
-    }
-    case 0x7: {
-      if (this->gpr[this->opcode.x] > this->gpr[this->opcode.y]) {
-        this->gpr[0xF] = 0;
-      } else {
-        this->gpr[0xF] = 1;
-      }
-      this->gpr[this->opcode.x] =
-          this->gpr[this->opcode.y] - this->gpr[this->opcode.x];
-    }
-    case 0xE: {
-      this->gpr[0xF] = (this->gpr[this->opcode.x] & 0x80) >> 7;
-      this->gpr[this->opcode.x] <<= 1;
-      break;
-    }
-    }
-    break;
-  case 0x09:
-    if (this->gpr[this->opcode.x] != this->gpr[this->opcode.y]) {
-      this->pc += 2;
-    }
-    break;
-  case 0x0A:
-    this->i = this->opcode.nnn;
-    break;
-  case 0x0B:
-      this->pc = this->opcode.nnn + this->gpr[0];
-    // this->pc = this->opcode.nnn + this->gpr[this->opcode.x];
-    break;
-  case 0x0C:
-    this->gpr[this->opcode.x] = (uint8_t)(rand() & this->opcode.nn);
-    break;
-  case 0x0D: {
-    uint8_t x = this->gpr[this->opcode.x] % 64;
-    uint8_t y = this->gpr[this->opcode.y] % 32;
-    uint8_t height = this->opcode.n;
-    uint8_t sprite_byte;
+// Reference path: fetches and decodes on every call, bypassing the cache.
+void Chip8::cycle_uncached() {
+  if ((size_t)this->pc + 1 >= this->mem_size) {
+    this->state = EmuState::PAUSED;
+    return;
+  }
 
-    this->gpr[0xF] = 0;
+  const Instruction op =
+      split((this->mem[this->pc] << 8) | (this->mem[this->pc + 1]));
+  PROFILE_INSTRUCTION(this->profiler, this->pc, op.inst);
+  this->pc += 2;
+  this->cycle_count++;
 
-    for (uint8_t row = 0; row < height; row++) {
-      if ((size_t)this->i + row >= sizeof(this->mem)) {
-        break;
-      }
-      uint8_t curr_y = y + row;
-      if (curr_y >= this->config.height) {
-        break;
-      }
+  this->decoder(op.inst)(*this, op);
+}
+
+// Per-instance xorshift32, so runs can be snapshotted and don't share state.
+uint8_t Chip8::random_byte() {
+  uint32_t x = this->rng_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  this->rng_state = x;
+  return (uint8_t)(x >> 24);
+}
+
+// Restarts the random number sequence CXNN draws from. Runs given the same
+// ROM, seed and input are identical.
+void Chip8::seed(uint32_t seed) {
+  this->rng_state = seed != 0 ? seed : 0x9E3779B9; // xorshift can't leave 0
+}
+
+// All stores into mem go through here so cached decodes of the (up to two)
+// instructions overlapping the byte are dropped.
+void Chip8::write_mem(uint16_t addr, uint8_t value) {
+  if (addr >= this->mem_size) {
+    return;
+  }
+  this->mem[addr] = value;
+  this->decoded[addr].handler = nullptr;
+  if (addr > 0) {
+    this->decoded[addr - 1].handler = nullptr;
+  }
+  if (this->block_code[addr]) {
+    this->blocks_stale = true;
+  }
+}
 
-      sprite_byte = this->mem[this->i + row];
+Chip8::~Chip8() {}
 
-      for (uint8_t col = 0; col < 8; col++) {
-        uint8_t curr_x = x + col;
-        if (curr_x >= this->config.width) {
-          break;
-        }
+// Ticks delay and sound. The beep is on while sound is still nonzero after
+// the tick; frontends poll sound_active() once per frame to synthesize it.
+void Chip8::update_timers() {
+  if (this->delay > 0) {
+    this->delay--;
+  }
+  if (this->sound > 0) {
+    this->sound--;
+  }
+  this->is_sound_active = this->sound > 0;
+}
 
-        if ((sprite_byte & (0x80 >> col))) {
-          if (this->display[curr_y][curr_x]) {
-            this->gpr[0xF] = 1;
-          }
-          this->display[curr_y][curr_x] ^= 1;
-        }
+// Decode cache loop for one frame. With QUIRK_DISPLAY_WAIT, DXYN ends the
+// frame; only that instantiation checks for it.
+template <bool display_wait> uint32_t Chip8::run_cached(uint32_t budget) {
+  uint32_t executed = 0;
+  while (executed < budget && this->state == EmuState::RUNNING) {
+    this->cycle();
+    executed++;
+    if constexpr (display_wait) {
+      if (this->vblank_wait) {
+        break;
       }
     }
-    break;
   }
-  case 0x0E:
-    switch (this->opcode.nn) {
-    case 0x9E:
-      if (this->keypad[this->gpr[this->opcode.x] & 0xF]) {
-        this->pc += 2;
-      }
-      break;
-    case 0xA1:
-      if (!this->keypad[this->gpr[this->opcode.x] & 0xF]) {
-        this->pc += 2;
-      }
-      break;
+  return executed;
+}
+
+// Runs the instructions of one frame on the configured backend.
+uint32_t Chip8::execute_frame(uint32_t inst_per_frame) {
+  uint32_t executed = 0;
+  // One test per frame, so an unarmed debugger or no tracer costs nothing
+  // per instruction
+  if ((this->debugger != nullptr && this->debugger->armed()) ||
+      this->tracer != nullptr) {
+    return this->run_debug(inst_per_frame);
+  }
+  if (this->config.timing == TIMING_VIP) {
+    return this->run_cycles(this->config.cycles_per_frame);
+  }
+  switch (this->config.backend) {
+  case BACKEND_UNCACHED:
+    // Reference path, so the display wait is a plain runtime check
+    while (executed < inst_per_frame && this->state == EmuState::RUNNING &&
+           !this->vblank_wait) {
+      this->cycle_uncached();
+      executed++;
     }
     break;
-  case 0x0F:
-    switch (this->opcode.nn) {
-    case 0x07:
-      this->gpr[this->opcode.x] = this->delay;
-      break;
-    case 0x0A: {
-      bool pressed = false;
-      for (uint8_t i = 0; i < sizeof(this->keypad) / sizeof(this->keypad[0]);
-           i++) {
-        if (this->keypad[i]) {
-          this->gpr[this->opcode.x] = i;
-          pressed = true;
-          break;
-        }
-      }
-      if (!pressed) {
-        this->pc -= 2;
-      }
-      break;
-    }
-    case 0x15:
-      this->delay = this->gpr[this->opcode.x];
-      break;
-    case 0x18:
-      this->sound = this->gpr[this->opcode.x];
-      break;
-    case 0x1E:
-      this->i += this->gpr[this->opcode.x];
-      if ((this->i >> 3) & 0x1) {
-        this->gpr[0xF] = 1;
-      }
-      break;
-    case 0x29:
-      this->i = (this->gpr[this->opcode.x] & 0xF) * 5 + 0x050;
-      break;
-    case 0x33: {
-      uint8_t num = this->gpr[this->opcode.x];
-      for (uint8_t digit = 0; digit < 3; digit++) {
-        uint8_t digit_extracted = num % 10;
-        num = num / 10;
-        this->mem[this->i + digit] = digit_extracted;
-      }
-      break;
-    }
-    case 0x55:
-      for (uint8_t offset = 0; offset <= this->opcode.x; offset++) {
-        this->mem[this->i + offset] = this->gpr[offset];
-      }
-      break;
-    case 0x65:
-      for (uint8_t offset = 0; offset <= this->opcode.x; offset++) {
-        this->gpr[offset] = this->mem[this->i + offset];
-      }
-      break;
+  case BACKEND_CACHED:
+    if (this->config.quirks & QUIRK_DISPLAY_WAIT) {
+      executed = this->run_cached<true>(inst_per_frame);
+    } else {
+      executed = this->run_cached<false>(inst_per_frame);
     }
     break;
+  case BACKEND_RECOMPILER:
+    executed = this->run_blocks(inst_per_frame);
+    break;
   }
+  return executed;
 }
 
-void Chip8::run() {
-  this->sdl.clear_screen(this->config.bg_color);
-  uint32_t last_timer_update_tick = SDL_GetTicks();
-  const uint32_t timer_update_interval_ms = 1000 / 60; // 60Hz
+// Executes one 60Hz frame worth of instructions back to back and then ticks
+// delay/sound once, so timers advance in emulated time no matter how fast the
+// host runs the frame. Returns the number of instructions executed.
+// With TIMING_VIP the frame is config.cycles_per_frame machine cycles
+// instead and inst_per_frame is ignored. A frame a debugger stops in returns
+// early and is finished by the next call.
+uint32_t Chip8::run_frame(uint32_t inst_per_frame) {
+  uint32_t executed;
+  this->vblank_wait = false;
+  {
+    PROFILE_SCOPE(this->profiler, PROFILE_EXECUTE);
+    executed = this->execute_frame(inst_per_frame);
+  }
+  // Stopped by the debugger partway: the rest of the frame runs on resume
+  if (this->frame_held) {
+    this->frame_held = false;
+    return executed;
+  }
+  {
+    PROFILE_SCOPE(this->profiler, PROFILE_TIMERS);
+    this->update_timers();
+  }
+  this->frame_count++;
+  if (this->tracer != nullptr) {
+    this->tracer->frame(this->frame_count);
+  }
 
-  uint32_t cycle_start_tick;
-  const double ms_per_instruction = 1000.0 / this->config.inst_per_sec;
+  if (this->frame_dirty) {
+    this->dirty_rows |= this->frame_dirty;
+    this->frame_dirty = 0;
+    this->display_version++;
+  }
+  return executed;
+}
 
-  while (this->state != EmuState::QUIT) {
-    cycle_start_tick = SDL_GetTicks();
+EmuState Chip8::get_state() const { return this->state; }
 
-    this->get_input();
+void Chip8::set_state(EmuState state) { this->state = state; }
 
-    if (this->state == EmuState::PAUSED) {
-      this->sdl.update_screen(this->config.fg_color, this->config.bg_color,
-                              this->config.scaling_factor, this->display);
-      SDL_Delay(100);                          // Reduce CPU usage when paused
-      last_timer_update_tick = SDL_GetTicks(); // Prevent timer catch-up burst
-      continue;
-    }
-    if (this->state == EmuState::QUIT) {
-      break;
-    }
+void Chip8::set_key(uint8_t key, bool pressed) {
+  this->keypad[key & 0xF] = pressed;
+}
 
-    // --- Emulation Cycle ---
-    // Run one instruction
-    if ((size_t)this->pc >= sizeof(this->mem) ||
-        (size_t)this->pc + 1 >= sizeof(this->mem)) {
-      this->state = PAUSED;
-      continue;
-    }
-    this->cycle();
+// Whole keypad as a bitmask, bit n = key n down.
+uint16_t Chip8::get_keys() const {
+  uint16_t keys = 0;
+  for (uint8_t key = 0; key < 16; key++) {
+    keys |= (uint16_t)this->keypad[key] << key;
+  }
+  return keys;
+}
 
-    // --- Timer Updates (at 60Hz) ---
-    uint32_t current_ticks = SDL_GetTicks();
-    if (current_ticks - last_timer_update_tick >= timer_update_interval_ms) {
-      this->update_timers();
-      // Also update screen at roughly 60Hz, coinciding with timer updates
-      this->sdl.update_screen(this->config.fg_color, this->config.bg_color,
-                              this->config.scaling_factor, this->display);
-      last_timer_update_tick =
-          current_ticks; // Or last_timer_update_tick +=
-                         // timer_update_interval_ms for more stable 60Hz
-    }
+void Chip8::set_keys(uint16_t keys) {
+  for (uint8_t key = 0; key < 16; key++) {
+    this->keypad[key] = (keys >> key) & 1;
+  }
+}
 
-    // --- Frame Limiting / IPS control ---
-    // Calculate how long this instruction cycle took
-    uint32_t instruction_time_ms = SDL_GetTicks() - cycle_start_tick;
+uint64_t Chip8::get_rom_hash() const { return this->rom_hash; }
 
-    // If the instruction executed faster than desired IPS rate, delay
-    if (instruction_time_ms < ms_per_instruction) {
-      SDL_Delay((uint32_t)(ms_per_instruction - instruction_time_ms));
-    }
-    // If overall loop is too fast and screen hasn't updated due to timer
-    // interval, we might add a small delay here too, but the screen update is
-    // tied to timer now. A more robust game loop might separate instruction
-    // execution rate from display rate. For now, tying screen update to timer
-    // update (both ~60Hz) is a common approach. The IPS is controlled by
-    // delaying after each instruction.
+bool Chip8::sound_active() const { return this->is_sound_active; }
+
+const uint8_t *Chip8::get_pattern() const { return this->pattern; }
+
+uint8_t Chip8::get_pitch() const { return this->pitch; }
+
+const config_t &Chip8::get_config() const { return this->config; }
+
+// Changing quirks or platform changes what every opcode decodes to, so
+// cached decodes and blocks are dropped.
+void Chip8::set_config(const config_t &config) {
+  const bool redecode = config.quirks != this->config.quirks ||
+                        config.platform != this->config.platform;
+  if (config.platform != this->config.platform) {
+    this->set_platform(config.platform);
+  }
+  this->config = config;
+  if (redecode) {
+    this->decoder = decoder_for(config.platform, config.quirks);
+    memset(this->decoded, 0, sizeof(this->decoded));
+    this->flush_blocks();
   }
 }
 
-void Chip8::get_input() {
-  SDL_Event event;
-
-  while (SDL_PollEvent(&event)) {
-    switch (event.type) {
-    case SDL_EVENT_QUIT:
-      this->state = EmuState::QUIT;
-      return; // Exit input handling immediately on quit
-
-    case SDL_EVENT_KEY_DOWN:
-      switch (event.key.scancode) {
-      case SDL_SCANCODE_ESCAPE:
-        this->state = EmuState::QUIT;
-        return;
-      case SDL_SCANCODE_SPACE: // Toggle pause/run
-        if (this->state == EmuState::RUNNING) {
-          this->state = EmuState::PAUSED;
-          puts("Emulator Paused.");
-        } else if (this->state == EmuState::PAUSED) {
-          this->state = EmuState::RUNNING;
-          puts("Emulator Resumed.");
-        }
-        break;
-
-      // CHIP-8 Key to QWERTY Mapping
-      case SDL_SCANCODE_1:
-        this->keypad[0x1] = true;
-        break;
-      case SDL_SCANCODE_2:
-        this->keypad[0x2] = true;
-        break;
-      case SDL_SCANCODE_3:
-        this->keypad[0x3] = true;
-        break;
-      case SDL_SCANCODE_4:
-        this->keypad[0xC] = true;
-        break; // C
+// Memory size, stack depth and the big font follow the platform. Meant to
+// be set before the program starts.
+void Chip8::set_platform(Platform platform) {
+  static const uint8_t big_font[160] = {
+      0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+      0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+      0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+      0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+      0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+      0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+      0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+      0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+      0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+      0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+      0x18, 0x3C, 0x66, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+      0xFC, 0xFE, 0xC3, 0xC3, 0xFE, 0xFE, 0xC3, 0xC3, 0xFE, 0xFC, // B
+      0x3C, 0x7E, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0x7E, 0x3C, // C
+      0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+      0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xFF, 0xFF, // E
+      0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xC0, 0xC0  // F
+  };
+  const bool super = platform == PLATFORM_SCHIP || platform == PLATFORM_XOCHIP;
+  this->flush_blocks(); // up to the old mem_size, set_config does the new
+  this->mem_size = platform == PLATFORM_XOCHIP ? MEM_SIZE : 4096;
+  this->stack_size = super ? 16 : 12;
+  for (uint32_t byte = 0; byte < sizeof(big_font); byte++) {
+    this->write_mem(BIG_FONT_ADDR + byte, super ? big_font[byte] : 0);
+  }
+}
 
-      case SDL_SCANCODE_Q:
-        this->keypad[0x4] = true;
-        break;
-      case SDL_SCANCODE_W:
-        this->keypad[0x5] = true;
-        break;
-      case SDL_SCANCODE_E:
-        this->keypad[0x6] = true;
-        break;
-      case SDL_SCANCODE_R:
-        this->keypad[0xD] = true;
-        break; // D
+uint64_t Chip8::get_cycle_count() const { return this->cycle_count; }
 
-      case SDL_SCANCODE_A:
-        this->keypad[0x7] = true;
-        break;
-      case SDL_SCANCODE_S:
-        this->keypad[0x8] = true;
-        break;
-      case SDL_SCANCODE_D:
-        this->keypad[0x9] = true;
-        break;
-      case SDL_SCANCODE_F:
-        this->keypad[0xE] = true;
-        break; // E
-
-      case SDL_SCANCODE_Z:
-        this->keypad[0xA] = true;
-        break; // A (Mapped to Z)
-      case SDL_SCANCODE_X:
-        this->keypad[0x0] = true;
-        break; // 0 (Mapped to X)
-      case SDL_SCANCODE_C:
-        this->keypad[0xB] = true;
-        break; // B (Mapped to C)
-      case SDL_SCANCODE_V:
-        this->keypad[0xF] = true;
-        break; // F (Mapped to V)
-      default:
-        break; // Ignore other keys
-      }
-      break;
+uint64_t Chip8::get_frame_count() const { return this->frame_count; }
 
-    case SDL_EVENT_KEY_UP:
-      switch (event.key.scancode) {
-      // CHIP-8 Key to QWERTY Mapping
-      case SDL_SCANCODE_1:
-        this->keypad[0x1] = false;
-        break;
-      case SDL_SCANCODE_2:
-        this->keypad[0x2] = false;
-        break;
-      case SDL_SCANCODE_3:
-        this->keypad[0x3] = false;
-        break;
-      case SDL_SCANCODE_4:
-        this->keypad[0xC] = false;
-        break;
+uint64_t Chip8::get_machine_cycles() const { return this->machine_cycles; }
 
-      case SDL_SCANCODE_Q:
-        this->keypad[0x4] = false;
-        break;
-      case SDL_SCANCODE_W:
-        this->keypad[0x5] = false;
-        break;
-      case SDL_SCANCODE_E:
-        this->keypad[0x6] = false;
-        break;
-      case SDL_SCANCODE_R:
-        this->keypad[0xD] = false;
-        break;
+const Display &Chip8::get_display() const { return this->display; }
 
-      case SDL_SCANCODE_A:
-        this->keypad[0x7] = false;
-        break;
-      case SDL_SCANCODE_S:
-        this->keypad[0x8] = false;
-        break;
-      case SDL_SCANCODE_D:
-        this->keypad[0x9] = false;
-        break;
-      case SDL_SCANCODE_F:
-        this->keypad[0xE] = false;
-        break;
+Resolution Chip8::get_resolution() const { return this->resolution; }
 
-      case SDL_SCANCODE_Z:
-        this->keypad[0xA] = false;
-        break; // A
-      case SDL_SCANCODE_X:
-        this->keypad[0x0] = false;
-        break; // 0
-      case SDL_SCANCODE_C:
-        this->keypad[0xB] = false;
-        break; // B
-      case SDL_SCANCODE_V:
-        this->keypad[0xF] = false;
-        break; // F
-      default:
-        break; // Ignore other keys
-      }
-      break;
-    default:
-      break; // Ignore other event types
-    }
-  }
+// Returns the rows changed since the last call (bit n = row n) and resets
+// them. A frontend only needs to upload those rows, and can skip presenting
+// altogether when nothing changed.
+uint64_t Chip8::take_dirty_rows() {
+  const uint64_t rows = this->dirty_rows | this->frame_dirty;
+  this->dirty_rows = 0;
+  return rows;
 }
 
-Chip8::~Chip8() {}
+// Incremented at the end of every frame that changed the display, so
+// callers can tell a new picture apart without comparing framebuffers.
+uint64_t Chip8::get_display_version() const { return this->display_version; }
 
-void Chip8::update_timers() {
-  if (this->delay > 0) {
-    this->delay--;
-  }
+// Starts feeding profiler, or stops with nullptr. Only CHIP8_PROFILE builds
+// feed it anything.
+void Chip8::set_profiler(Profiler *profiler) { this->profiler = profiler; }
 
-  if (this->sound > 0) {
-    if (!this->is_sound_active) {
-      // platform_start_beep();
-      this->is_sound_active = true;
-    }
-    this->sound--;
-    if (this->sound == 0) {
-      if (this->is_sound_active) {
-        // platform_stop_beep();
-        this->is_sound_active = false;
-      }
-    }
-  } else {
-    if (this->is_sound_active) {
-      // platform_stop_beep();
-      this->is_sound_active = false;
-    }
-  }
+Profiler *Chip8::get_profiler() const { return this->profiler; }
+
+// FNV-1a over the framebuffer, used by headless runs to compare output.
+uint64_t Chip8::display_hash() const {
+  return hash_display(this->display, this->resolution);
 }
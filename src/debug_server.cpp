@@ -0,0 +1,370 @@
+#include "debug_server.hpp"
+#include "snapshot.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#define DEBUG_MAX_READ 0x1000 // longest m reply, in bytes of memory
+
+static std::string hex(uint32_t value, int digits) {
+  char text[16];
+  snprintf(text, sizeof(text), "%0*X", digits, value);
+  return text;
+}
+
+// Reads a hex number at pos and moves pos past it. False if there is none
+// or it doesn't fit in limit.
+static bool parse_hex(const std::string &text, size_t &pos, uint32_t limit,
+                      uint32_t &value) {
+  const size_t start = pos;
+  value = 0;
+  while (pos < text.size() && isxdigit((unsigned char)text[pos])) {
+    const char digit = (char)tolower((unsigned char)text[pos]);
+    value = value * 16 + (digit <= '9' ? digit - '0' : digit - 'a' + 10);
+    if (value > limit) {
+      return false;
+    }
+    pos++;
+  }
+  return pos > start;
+}
+
+// ADDR or ADDR,LEN after a command prefix, nothing else after them.
+static bool parse_args(const std::string &text, size_t pos, uint32_t &addr,
+                       uint32_t *size) {
+  if (!parse_hex(text, pos, MEM_SIZE - 1, addr)) {
+    return false;
+  }
+  if (size != nullptr) {
+    if (pos >= text.size() || text[pos++] != ',' ||
+        !parse_hex(text, pos, MEM_SIZE, *size) || *size == 0) {
+      return false;
+    }
+  }
+  return pos == text.size();
+}
+
+Debug_server::Debug_server(Chip8 &chip, Debugger &debugger)
+    : chip(chip), debugger(debugger), listener(-1), input(-1), output(-1),
+      reported(false) {}
+
+#if defined(_WIN32)
+
+bool Debug_server::open(const char *) {
+  std::cerr << "The debugger is not available on Windows" << std::endl;
+  return false;
+}
+
+bool Debug_server::receive(bool) { return false; }
+
+bool Debug_server::read_line(std::string &) { return false; }
+
+void Debug_server::reply(const std::string &) {}
+
+void Debug_server::close_client() {}
+
+#else
+
+bool Debug_server::open(const char *where) {
+  if (strcmp(where, "-") == 0) {
+    this->input = STDIN_FILENO;
+    this->output = STDOUT_FILENO;
+    this->debugger.interrupt();
+    return true;
+  }
+
+  char *end = nullptr;
+  const long port = strtol(where, &end, 10);
+  const bool tcp = *end == '\0' && port > 0 && port < 65536;
+  if (tcp) {
+    this->listener = socket(AF_INET, SOCK_STREAM, 0);
+    const int reuse = 1;
+    setsockopt(this->listener, SOL_SOCKET, SO_REUSEADDR, &reuse,
+               sizeof(reuse));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // local only
+    if (this->listener < 0 ||
+        bind(this->listener, (sockaddr *)&address, sizeof(address)) != 0) {
+      return false;
+    }
+  } else {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (strlen(where) >= sizeof(address.sun_path)) {
+      return false;
+    }
+    strcpy(address.sun_path, where);
+    // A socket left behind by an earlier run, never anything else
+    struct stat st;
+    if (stat(where, &st) == 0 && S_ISSOCK(st.st_mode)) {
+      unlink(where);
+    }
+    this->listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (this->listener < 0 ||
+        bind(this->listener, (sockaddr *)&address, sizeof(address)) != 0) {
+      return false;
+    }
+  }
+
+  if (listen(this->listener, 1) != 0) {
+    return false;
+  }
+  std::cerr << "Waiting for a debugger on " << where << std::endl;
+  const int client = accept(this->listener, nullptr, nullptr);
+  close(this->listener);
+  this->listener = -1;
+  if (!tcp) {
+    unlink(where);
+  }
+  if (client < 0) {
+    return false;
+  }
+  signal(SIGPIPE, SIG_IGN); // a client going away is EOF, not a crash
+  this->input = client;
+  this->output = client;
+  this->debugger.interrupt();
+  return true;
+}
+
+// Appends whatever input has arrived to pending, waiting for some if asked
+// to. False if nothing came, or the client went away (input is -1 then).
+bool Debug_server::receive(bool wait) {
+  while (this->input >= 0) {
+    pollfd ready = {this->input, POLLIN, 0};
+    const int events = poll(&ready, 1, wait ? -1 : 0);
+    if (events < 0 && errno == EINTR) {
+      continue;
+    }
+    if (events == 0) {
+      return false;
+    }
+    char buffer[512];
+    const ssize_t got =
+        events > 0 ? read(this->input, buffer, sizeof(buffer)) : -1;
+    if (got <= 0) {
+      this->close_client();
+      return false;
+    }
+    this->pending.append(buffer, (size_t)got);
+    return true;
+  }
+  return false;
+}
+
+// Next command line, waiting for one. Interrupts are dropped, the machine
+// is stopped already. False if the client went away.
+bool Debug_server::read_line(std::string &line) {
+  while (this->input >= 0) {
+    const size_t newline = this->pending.find('\n');
+    if (newline != std::string::npos) {
+      line = this->pending.substr(0, newline);
+      this->pending.erase(0, newline + 1);
+      line.erase(std::remove(line.begin(), line.end(), '\x03'), line.end());
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      return true;
+    }
+    this->receive(true);
+  }
+  return false;
+}
+
+void Debug_server::reply(const std::string &text) {
+  const std::string line = text + "\n";
+  size_t sent = 0;
+  while (this->output >= 0 && sent < line.size()) {
+    const ssize_t wrote =
+        write(this->output, line.data() + sent, line.size() - sent);
+    if (wrote < 0 && errno == EINTR) {
+      continue;
+    }
+    if (wrote <= 0) {
+      this->close_client();
+      return;
+    }
+    sent += (size_t)wrote;
+  }
+}
+
+// The client is gone: nothing stays armed and the machine runs on.
+void Debug_server::close_client() {
+  if (this->input > STDERR_FILENO) {
+    close(this->input);
+  }
+  this->input = -1;
+  this->output = -1;
+  this->debugger.clear();
+  this->debugger.resume();
+}
+
+#endif
+
+std::string Debug_server::stop_reply() const {
+  auto state = std::make_unique<Snapshot>();
+  this->chip.save_state(*state);
+
+  std::string text;
+  switch (this->debugger.get_stop()) {
+  case DEBUG_BREAKPOINT:
+    text = "T05swbreak:;";
+    break;
+  case DEBUG_WATCHPOINT:
+    text = "T05watch:" + hex(this->debugger.get_stop_addr(), 4) + ";";
+    break;
+  case DEBUG_STEP:
+    text = "T05";
+    break;
+  case DEBUG_INTERRUPT:
+    text = "T02";
+    break;
+  case DEBUG_HALT:
+    text = "T06";
+    break;
+  case DEBUG_RUNNING:
+    return "OK";
+  }
+  return text + "pc:" + hex(state->pc, 4) + ";";
+}
+
+// Runs one command. False if it ends the session.
+bool Debug_server::command(const std::string &line) {
+  auto state = std::make_unique<Snapshot>();
+  this->chip.save_state(*state);
+  const bool halted = this->chip.get_state() != EmuState::RUNNING;
+  uint32_t addr = 0;
+  uint32_t size = 0;
+
+  if (line.empty()) {
+    return true;
+  } else if (line == "?") {
+    this->reply(this->stop_reply());
+  } else if (line == "g") {
+    std::string text;
+    for (uint32_t reg = 0; reg < 16; reg++) {
+      text += std::string("v") + "0123456789abcdef"[reg] + ":" +
+              hex(state->gpr[reg], 2) + ";";
+    }
+    text += "i:" + hex(state->i, 4) + ";pc:" + hex(state->pc, 4) +
+            ";sp:" + hex(state->sp, 2) + ";dt:" + hex(state->delay, 2) +
+            ";st:" + hex(state->sound, 2) + ";";
+    this->reply(text);
+  } else if (line[0] == 'm' &&
+             parse_args(line, line[1] == ' ' ? 2 : 1, addr, &size) &&
+             size <= DEBUG_MAX_READ) {
+    std::string text;
+    for (uint32_t byte = 0; byte < size; byte++) {
+      text += hex(state->mem[(addr + byte) & (MEM_SIZE - 1)], 2);
+    }
+    this->reply(text);
+  } else if (line == "qStack") {
+    std::string text = "stack:";
+    for (uint32_t level = 0; level < state->sp && level < 16; level++) {
+      text += hex(state->stack[level], 4) + ";";
+    }
+    this->reply(text);
+  } else if ((line.rfind("Z0,", 0) == 0 || line.rfind("z0,", 0) == 0) &&
+             parse_args(line, 3, addr, nullptr)) {
+    this->debugger.set_breakpoint((uint16_t)addr, line[0] == 'Z');
+    this->reply("OK");
+  } else if ((line.rfind("Z2,", 0) == 0 || line.rfind("z2,", 0) == 0) &&
+             parse_args(line, 3, addr, &size)) {
+    this->debugger.set_watchpoint((uint16_t)addr, (uint16_t)size,
+                                  line[0] == 'Z');
+    this->reply("OK");
+  } else if (line == "s" || line == "n" || line == "c") {
+    // A halted machine can't go anywhere, say so again
+    if (halted) {
+      this->debugger.halt();
+      this->reply(this->stop_reply());
+    } else if (line == "s") {
+      this->debugger.step();
+    } else if (line == "n") {
+      const uint16_t inst =
+          (state->mem[state->pc] << 8) | state->mem[(state->pc + 1) & 0xFFFF];
+      this->debugger.step_over(state->pc, inst, state->sp);
+    } else {
+      this->debugger.resume();
+    }
+  } else if (line == "D") {
+    this->reply("OK");
+    this->close_client();
+    return false;
+  } else if (line == "k") {
+    this->chip.set_state(EmuState::QUIT);
+    this->reply("OK");
+    this->close_client();
+    return false;
+  } else if (strchr("mZz", line[0]) != nullptr) {
+    this->reply("E01");
+  } else {
+    this->reply("");
+  }
+  return true;
+}
+
+bool Debug_server::serve() {
+  if (this->input < 0) {
+    return false;
+  }
+  // The machine can stop itself on a backend that doesn't ask the debugger
+  if (this->chip.get_state() != EmuState::RUNNING &&
+      !this->debugger.stopped()) {
+    this->debugger.halt();
+  }
+
+  if (!this->debugger.stopped()) {
+    if (!this->receive(false)) {
+      return this->input >= 0;
+    }
+    const size_t brk = this->pending.find('\x03');
+    if (brk == std::string::npos) {
+      return true;
+    }
+    this->pending.erase(brk, 1);
+    this->debugger.interrupt();
+  }
+
+  std::string line;
+  while (this->debugger.stopped()) {
+    if (!this->reported) {
+      this->reply(this->stop_reply());
+      this->reported = true;
+    }
+    if (!this->read_line(line) || !this->command(line)) {
+      return false;
+    }
+  }
+  this->reported = false;
+  return this->input >= 0;
+}
+
+Debug_server::~Debug_server() {
+#if !defined(_WIN32)
+  if (this->listener >= 0) {
+    close(this->listener);
+  }
+  if (this->input > STDERR_FILENO) {
+    close(this->input);
+  }
+#endif
+}
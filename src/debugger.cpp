@@ -0,0 +1,203 @@
+#include "debugger.hpp"
+#include "chip8.hpp"
+#include "timing.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+Debugger::Debugger()
+    : breakpoints(MEM_SIZE, 0), watchpoints(MEM_SIZE, 0), armed_points(0),
+      stop(DEBUG_RUNNING), stop_addr(0), stepping(STEP_NONE), step_pc(0),
+      step_sp(0), resuming(false) {}
+
+void Debugger::set_breakpoint(uint16_t addr, bool on) {
+  if (this->breakpoints[addr] != on) {
+    this->breakpoints[addr] = on;
+    this->armed_points += on ? 1 : -1;
+  }
+}
+
+// Watches size bytes from addr, wrapping at the end of memory like I does.
+void Debugger::set_watchpoint(uint16_t addr, uint16_t size, bool on) {
+  for (uint32_t byte = 0; byte < size; byte++) {
+    const uint16_t watched = (uint16_t)(addr + byte);
+    if (this->watchpoints[watched] != on) {
+      this->watchpoints[watched] = on;
+      this->armed_points += on ? 1 : -1;
+    }
+  }
+}
+
+bool Debugger::has_breakpoint(uint16_t addr) const {
+  return this->breakpoints[addr] != 0;
+}
+
+// Drops every breakpoint and watchpoint. A stop or step is left alone.
+void Debugger::clear() {
+  std::fill(this->breakpoints.begin(), this->breakpoints.end(), 0);
+  std::fill(this->watchpoints.begin(), this->watchpoints.end(), 0);
+  this->armed_points = 0;
+}
+
+Debug_stop Debugger::get_stop() const { return this->stop; }
+
+uint16_t Debugger::get_stop_addr() const { return this->stop_addr; }
+
+void Debugger::resume() {
+  this->resuming = this->stop == DEBUG_BREAKPOINT;
+  this->stop = DEBUG_RUNNING;
+  this->stepping = STEP_NONE;
+}
+
+void Debugger::step() {
+  this->resume();
+  this->stepping = STEP_INTO;
+}
+
+void Debugger::step_over(uint16_t pc, uint16_t inst, uint8_t sp) {
+  this->resume();
+  if ((inst >> 12) == 0x2) {
+    this->stepping = STEP_OVER;
+    this->step_pc = pc + 2;
+    this->step_sp = sp;
+  } else {
+    this->stepping = STEP_INTO;
+  }
+}
+
+void Debugger::interrupt() {
+  if (this->stop == DEBUG_RUNNING) {
+    this->stop = DEBUG_INTERRUPT;
+  }
+  this->stepping = STEP_NONE;
+}
+
+void Debugger::halt() {
+  this->stop = DEBUG_HALT;
+  this->stepping = STEP_NONE;
+}
+
+// An instruction just stored size bytes from addr.
+bool Debugger::stored(uint16_t addr, uint32_t size) {
+  for (uint32_t byte = 0; byte < size; byte++) {
+    const uint16_t written = (uint16_t)(addr + byte);
+    if (this->watchpoints[written]) {
+      this->stop = DEBUG_WATCHPOINT;
+      this->stop_addr = written;
+      this->stepping = STEP_NONE;
+      return true;
+    }
+  }
+  return false;
+}
+
+// An instruction just finished, leaving the machine at pc with sp.
+bool Debugger::after(uint16_t pc, uint8_t sp) {
+  if (this->stepping == STEP_INTO ||
+      (this->stepping == STEP_OVER && pc == this->step_pc &&
+       sp == this->step_sp)) {
+    this->stop = DEBUG_STEP;
+    this->stepping = STEP_NONE;
+    return true;
+  }
+  return false;
+}
+
+// Bytes an instruction stores at I: FX33, FX55 and XO-CHIP's 5XY2. Anything
+// else leaves memory alone.
+static uint32_t store_size(const Instruction &op, Platform platform) {
+  if ((op.inst & 0xF0FF) == 0xF033) {
+    return 3;
+  }
+  if ((op.inst & 0xF0FF) == 0xF055) {
+    return op.x + 1;
+  }
+  if ((op.inst & 0xF00F) == 0x5002 && platform == PLATFORM_XOCHIP) {
+    return (op.x > op.y ? op.x - op.y : op.y - op.x) + 1;
+  }
+  return 0;
+}
+
+// One frame with the debugger armed or a tracer attached: instruction by
+// instruction on the configured backend's interpreter, asking the debugger
+// before and after each one and recording each one to the tracer. Budgets
+// by instructions or VIP cycles like execute_frame(),
+// carrying what the frame has used so far across a stop in frame_spent
+// (cycle_debt for VIP timing), so a frame run in pieces executes exactly
+// what it would have in one go.
+uint32_t Chip8::run_debug(uint32_t inst_per_frame) {
+  Debugger *debugger = this->debugger;
+  Tracer *tracer = this->tracer;
+  const bool vip = this->config.timing == TIMING_VIP;
+  const uint32_t budget = vip ? this->config.cycles_per_frame : inst_per_frame;
+  uint32_t spent = vip ? this->cycle_debt : this->frame_spent;
+  uint32_t executed = 0;
+  bool held = false;
+
+  while (spent < budget && this->state == EmuState::RUNNING) {
+    if (debugger != nullptr &&
+        (debugger->stopped() || debugger->before(this->pc))) {
+      held = true;
+      break;
+    }
+    if ((size_t)this->pc + 1 >= this->mem_size) {
+      this->cycle(); // pauses
+      break;
+    }
+
+    const Instruction op =
+        split((this->mem[this->pc] << 8) | this->mem[this->pc + 1]);
+    const uint16_t pc = this->pc;
+    const uint16_t i = this->i;
+    uint8_t gpr[16];
+    if (tracer != nullptr) {
+      memcpy(gpr, this->gpr, sizeof(gpr));
+    }
+    if (this->config.backend == BACKEND_UNCACHED) {
+      this->cycle_uncached();
+    } else {
+      this->cycle();
+    }
+    executed++;
+    if (vip) {
+      const uint32_t cost = vip_cycles(op);
+      this->machine_cycles += cost;
+      spent = (op.inst >> 12) == 0xD ? budget + cost : spent + cost;
+    } else {
+      spent++;
+    }
+
+    if (tracer != nullptr) {
+      this->trace(pc, op.inst, gpr, i);
+    }
+    const uint32_t stored = store_size(op, this->config.platform);
+    if (debugger != nullptr &&
+        ((stored > 0 && debugger->stored(i, stored)) ||
+         debugger->after(this->pc, this->sp))) {
+      // else the frame is over anyway: out of budget, a display wait, or
+      // the machine stopped
+      held = spent < budget && !this->vblank_wait &&
+             this->state == EmuState::RUNNING;
+      break;
+    }
+    if (!vip && this->vblank_wait) {
+      break;
+    }
+  }
+
+  if (debugger != nullptr && this->state != EmuState::RUNNING &&
+      !debugger->stopped()) {
+    debugger->halt();
+  }
+  if (vip) {
+    this->cycle_debt = held ? spent : (spent > budget ? spent - budget : 0);
+  } else {
+    this->frame_spent = held ? spent : 0;
+  }
+  this->frame_held = held;
+  return executed;
+}
+
+void Chip8::set_debugger(Debugger *debugger) { this->debugger = debugger; }
+
+Debugger *Chip8::get_debugger() const { return this->debugger; }
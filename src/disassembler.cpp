@@ -0,0 +1,406 @@
+#include "disassembler.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <set>
+
+std::string disassemble(uint16_t inst, uint16_t next, Platform platform) {
+  const bool hires = platform == PLATFORM_CHIP8_HIRES;
+  const bool super =
+      platform == PLATFORM_SCHIP || platform == PLATFORM_XOCHIP;
+  const bool xo = platform == PLATFORM_XOCHIP;
+  const uint32_t x = (inst >> 8) & 0xF;
+  const uint32_t y = (inst >> 4) & 0xF;
+  const uint32_t n = inst & 0xF;
+  const uint32_t nn = inst & 0xFF;
+  const uint32_t nnn = inst & 0xFFF;
+
+  char text[32];
+  const char *plain = nullptr; // mnemonic without operands
+  switch (inst >> 12) {
+  case 0x0:
+    if (super && (inst & 0xFFF0) == 0x00C0) {
+      snprintf(text, sizeof(text), "SCD %u", n);
+    } else if (xo && (inst & 0xFFF0) == 0x00D0) {
+      snprintf(text, sizeof(text), "SCU %u", n);
+    } else if (inst == 0x00E0 || (hires && inst == 0x0230)) {
+      plain = "CLS";
+    } else if (inst == 0x00EE) {
+      plain = "RET";
+    } else if (super && inst == 0x00FB) {
+      plain = "SCR";
+    } else if (super && inst == 0x00FC) {
+      plain = "SCL";
+    } else if (super && inst == 0x00FD) {
+      plain = "EXIT";
+    } else if (super && inst == 0x00FE) {
+      plain = "LOW";
+    } else if (super && inst == 0x00FF) {
+      plain = "HIGH";
+    } else {
+      snprintf(text, sizeof(text), "SYS 0x%03X", nnn);
+    }
+    break;
+  case 0x1:
+    snprintf(text, sizeof(text), "JP 0x%03X", nnn);
+    break;
+  case 0x2:
+    snprintf(text, sizeof(text), "CALL 0x%03X", nnn);
+    break;
+  case 0x3:
+    snprintf(text, sizeof(text), "SE V%X, 0x%02X", x, nn);
+    break;
+  case 0x4:
+    snprintf(text, sizeof(text), "SNE V%X, 0x%02X", x, nn);
+    break;
+  case 0x5:
+    if (xo && n == 0x2) {
+      snprintf(text, sizeof(text), "SAVE V%X-V%X", x, y);
+    } else if (xo && n == 0x3) {
+      snprintf(text, sizeof(text), "LOAD V%X-V%X", x, y);
+    } else {
+      snprintf(text, sizeof(text), "SE V%X, V%X", x, y);
+    }
+    break;
+  case 0x6:
+    snprintf(text, sizeof(text), "LD V%X, 0x%02X", x, nn);
+    break;
+  case 0x7:
+    snprintf(text, sizeof(text), "ADD V%X, 0x%02X", x, nn);
+    break;
+  case 0x8: {
+    static const char *alu[16] = {"LD",  "OR",   "AND", "XOR", "ADD", "SUB",
+                                  "SHR", "SUBN", NULL,  NULL,  NULL,  NULL,
+                                  NULL,  NULL,   "SHL", NULL};
+    if (alu[n] != nullptr) {
+      snprintf(text, sizeof(text), "%s V%X, V%X", alu[n], x, y);
+    } else {
+      snprintf(text, sizeof(text), "DW 0x%04X", inst);
+    }
+    break;
+  }
+  case 0x9:
+    snprintf(text, sizeof(text), "SNE V%X, V%X", x, y);
+    break;
+  case 0xA:
+    snprintf(text, sizeof(text), "LD I, 0x%03X", nnn);
+    break;
+  case 0xB:
+    snprintf(text, sizeof(text), "JP V0, 0x%03X", nnn);
+    break;
+  case 0xC:
+    snprintf(text, sizeof(text), "RND V%X, 0x%02X", x, nn);
+    break;
+  case 0xD:
+    snprintf(text, sizeof(text), "DRW V%X, V%X, %u", x, y, n);
+    break;
+  case 0xE:
+    if (nn == 0x9E) {
+      snprintf(text, sizeof(text), "SKP V%X", x);
+    } else if (nn == 0xA1) {
+      snprintf(text, sizeof(text), "SKNP V%X", x);
+    } else {
+      snprintf(text, sizeof(text), "DW 0x%04X", inst);
+    }
+    break;
+  default: { // 0xF
+    static const struct {
+      uint8_t nn;
+      const char *format;
+      bool super; // SUPER-CHIP and XO-CHIP only
+      bool xo;    // XO-CHIP only
+    } ops[] = {
+        {0x07, "LD V%X, DT", false, false}, {0x0A, "LD V%X, K", false, false},
+        {0x15, "LD DT, V%X", false, false}, {0x18, "LD ST, V%X", false, false},
+        {0x1E, "ADD I, V%X", false, false}, {0x29, "LD F, V%X", false, false},
+        {0x30, "LD HF, V%X", true, false},  {0x33, "LD B, V%X", false, false},
+        {0x3A, "PITCH V%X", true, true},    {0x55, "LD [I], V%X", false, false},
+        {0x65, "LD V%X, [I]", false, false}, {0x75, "LD R, V%X", true, false},
+        {0x85, "LD V%X, R", true, false},   {0x01, "PLANE %u", true, true},
+    };
+    if (xo && inst == 0xF000) {
+      snprintf(text, sizeof(text), "LD I, 0x%04X", next);
+      break;
+    }
+    if (xo && inst == 0xF002) {
+      plain = "AUDIO";
+      break;
+    }
+    snprintf(text, sizeof(text), "DW 0x%04X", inst);
+    for (const auto &op : ops) {
+      if (op.nn == nn && (!op.super || super) && (!op.xo || xo)) {
+        snprintf(text, sizeof(text), op.format, x);
+      }
+    }
+    break;
+  }
+  }
+  return plain != nullptr ? plain : text;
+}
+
+uint32_t instruction_size(uint16_t inst, Platform platform) {
+  return platform == PLATFORM_XOCHIP && inst == 0xF000 ? 4 : 2;
+}
+
+static bool is_skip(uint16_t inst, Platform platform) {
+  switch (inst >> 12) {
+  case 0x3:
+  case 0x4:
+  case 0x9:
+    return true;
+  case 0x5: // XO-CHIP's 5XY2/5XY3 aren't
+    return platform != PLATFORM_XOCHIP ||
+           ((inst & 0xF) != 0x2 && (inst & 0xF) != 0x3);
+  case 0xE:
+    return (inst & 0xFF) == 0x9E || (inst & 0xFF) == 0xA1;
+  default:
+    return false;
+  }
+}
+
+// Instruction word at addr, 0 past the end of the ROM like empty memory
+static uint16_t word_at(const Rom &rom, uint32_t addr) {
+  const uint32_t offset = addr - ROM_ENTRY_POINT;
+  if (addr < ROM_ENTRY_POINT || offset >= rom.size) {
+    return 0;
+  }
+  const uint8_t low = offset + 1 < rom.size ? rom.data[offset + 1] : 0;
+  return (uint16_t)(rom.data[offset] << 8 | low);
+}
+
+Rom_graph analyze(const Rom &rom, Platform platform) {
+  Rom_graph graph;
+  graph.platform = platform;
+  graph.size = rom.size;
+  const uint32_t end = ROM_ENTRY_POINT + rom.size;
+  graph.kinds.assign(end, BYTE_DATA);
+  const auto in_rom = [&](uint32_t addr) {
+    return addr >= ROM_ENTRY_POINT && addr + 1 < end;
+  };
+
+  // Pass 1: walk every path, marking code and collecting block starts
+  std::set<uint16_t> leaders;
+  std::vector<uint16_t> work;
+  std::vector<bool> visited(end, false);
+  const auto add_leader = [&](uint32_t addr) {
+    if (leaders.insert((uint16_t)addr).second) {
+      work.push_back((uint16_t)addr);
+    }
+  };
+  add_leader(ROM_ENTRY_POINT);
+  while (!work.empty()) {
+    uint32_t addr = work.back();
+    work.pop_back();
+    while (in_rom(addr) && !visited[addr]) {
+      visited[addr] = true;
+      const uint16_t inst = word_at(rom, addr);
+      const uint32_t size = instruction_size(inst, platform);
+      graph.kinds[addr] = BYTE_CODE;
+      for (uint32_t byte = addr + 1; byte < addr + size && byte < end;
+           byte++) {
+        graph.kinds[byte] = BYTE_OPERAND;
+      }
+      const uint32_t next = addr + size;
+
+      if ((inst & 0xF000) == 0x1000) {
+        // The two-page hires interpreter's 1260 at 0x200 starts at 0x2C0
+        const bool hires_start = platform == PLATFORM_CHIP8_HIRES &&
+                                 inst == 0x1260 && addr == ROM_ENTRY_POINT;
+        add_leader(hires_start ? 0x2C0 : inst & 0xFFF);
+        break;
+      }
+      if ((inst & 0xF000) == 0x2000) {
+        graph.calls[inst & 0xFFF]++;
+        add_leader(inst & 0xFFF);
+        add_leader(next);
+        break;
+      }
+      if ((inst & 0xF000) == 0xB000) {
+        // Jump table: consecutive jumps at NNN, one per V0 value
+        add_leader(inst & 0xFFF);
+        for (uint32_t entry = inst & 0xFFF;
+             in_rom(entry) && (word_at(rom, entry) & 0xF000) == 0x1000;
+             entry += 2) {
+          add_leader(entry);
+        }
+        break;
+      }
+      if (inst == 0x00EE || (inst == 0x00FD && platform != PLATFORM_CHIP8 &&
+                             platform != PLATFORM_CHIP8_HIRES)) {
+        break;
+      }
+      if (is_skip(inst, platform)) {
+        add_leader(next);
+        add_leader(next + instruction_size(word_at(rom, next), platform));
+        break;
+      }
+      if ((inst & 0xF000) == 0xA000 && in_rom(inst & 0xFFF)) {
+        graph.pointers[inst & 0xFFF]++;
+      }
+      addr = next;
+      if (in_rom(addr) && visited[addr]) {
+        add_leader(addr); // ran into code found before, so paths join here
+      }
+    }
+  }
+
+  // Pass 2: cut the code into blocks at the leaders
+  for (uint16_t start : leaders) {
+    if (!in_rom(start) || !visited[start]) {
+      continue;
+    }
+    Cfg_block block = {start, start, EXIT_STOP, {}};
+    uint32_t addr = start;
+    while (true) {
+      if (!in_rom(addr)) {
+        block.exit = EXIT_STOP;
+        break;
+      }
+      const uint16_t inst = word_at(rom, addr);
+      const uint32_t next = addr + instruction_size(inst, platform);
+      block.end = (uint16_t)std::min(next, end);
+      if ((inst & 0xF000) == 0x1000) {
+        const bool hires_start = platform == PLATFORM_CHIP8_HIRES &&
+                                 inst == 0x1260 && addr == ROM_ENTRY_POINT;
+        block.exit = EXIT_JUMP;
+        block.successors = {(uint16_t)(hires_start ? 0x2C0 : inst & 0xFFF)};
+        break;
+      }
+      if ((inst & 0xF000) == 0x2000) {
+        block.exit = EXIT_CALL;
+        block.successors = {(uint16_t)next};
+        break;
+      }
+      if ((inst & 0xF000) == 0xB000) {
+        block.exit = EXIT_INDIRECT;
+        for (uint32_t entry = inst & 0xFFF;; entry += 2) {
+          block.successors.push_back((uint16_t)entry);
+          if (!in_rom(entry) || (word_at(rom, entry) & 0xF000) != 0x1000) {
+            break;
+          }
+        }
+        break;
+      }
+      if (inst == 0x00EE) {
+        block.exit = EXIT_RETURN;
+        break;
+      }
+      if (inst == 0x00FD && platform != PLATFORM_CHIP8 &&
+          platform != PLATFORM_CHIP8_HIRES) {
+        block.exit = EXIT_STOP;
+        break;
+      }
+      if (is_skip(inst, platform)) {
+        block.exit = EXIT_SKIP;
+        block.successors = {
+            (uint16_t)next,
+            (uint16_t)(next + instruction_size(word_at(rom, next), platform))};
+        break;
+      }
+      if (leaders.count((uint16_t)next)) {
+        block.exit = EXIT_FALL;
+        block.successors = {(uint16_t)next};
+        break;
+      }
+      addr = next;
+    }
+    graph.blocks[start] = block;
+  }
+  return graph;
+}
+
+static const char *platform_label(Platform platform) {
+  static const char *names[] = {"CHIP-8", "CHIP-8 two-page hires",
+                                "SUPER-CHIP", "XO-CHIP"};
+  return names[platform];
+}
+
+void write_listing(std::ostream &out, const Rom &rom,
+                   const Rom_graph &graph) {
+  const uint32_t end = ROM_ENTRY_POINT + graph.size;
+  out << "; " << platform_label(graph.platform) << ", " << graph.size
+      << " bytes, " << graph.blocks.size() << " blocks, "
+      << graph.calls.size() << " subroutines\n";
+
+  char line[64];
+  uint32_t addr = ROM_ENTRY_POINT;
+  while (addr < end) {
+    if (graph.calls.count(addr)) {
+      snprintf(line, sizeof(line), "\nsub_%03X:", addr);
+      out << line << "\n";
+    } else if (graph.blocks.count(addr)) {
+      snprintf(line, sizeof(line), "L_%03X:", addr);
+      out << line << "\n";
+    } else if (graph.pointers.count(addr)) {
+      snprintf(line, sizeof(line), "data_%03X:", addr);
+      out << line << "\n";
+    }
+
+    if (graph.kinds[addr] == BYTE_CODE) {
+      const uint16_t inst = word_at(rom, addr);
+      const uint32_t size = instruction_size(inst, graph.platform);
+      const uint16_t next = word_at(rom, addr + 2);
+      if (size == 4) {
+        snprintf(line, sizeof(line), "  %03X  %04X %04X  ", addr, inst, next);
+      } else {
+        snprintf(line, sizeof(line), "  %03X  %04X       ", addr, inst);
+      }
+      out << line << disassemble(inst, next, graph.platform) << "\n";
+      addr += size;
+      continue;
+    }
+
+    // Data: up to 8 bytes a line, up to the next code or label
+    snprintf(line, sizeof(line), "  %03X  DB", addr);
+    out << line;
+    uint32_t count = 0;
+    do {
+      snprintf(line, sizeof(line), " %02X", rom.data[addr - ROM_ENTRY_POINT]);
+      out << line;
+      addr++;
+      count++;
+    } while (addr < end && count < 8 && graph.kinds[addr] != BYTE_CODE &&
+             !graph.pointers.count(addr) && !graph.blocks.count(addr));
+    out << "\n";
+  }
+}
+
+void write_dot(std::ostream &out, const Rom &rom, const Rom_graph &graph) {
+  static const char *exits[] = {"",     "jump", "call", "return",
+                                "skip", "indirect", "stop"};
+  out << "digraph rom {\n";
+  out << "  node [shape=box, fontname=\"monospace\"];\n";
+  char line[64];
+  for (const auto &[start, block] : graph.blocks) {
+    snprintf(line, sizeof(line), "  b%03X [label=\"", start);
+    out << line;
+    if (graph.calls.count(start)) {
+      snprintf(line, sizeof(line), "sub_%03X\\l", start);
+      out << line;
+    }
+    for (uint32_t addr = start; addr < block.end;) {
+      const uint16_t inst = word_at(rom, addr);
+      snprintf(line, sizeof(line), "%03X  ", addr);
+      out << line << disassemble(inst, word_at(rom, addr + 2), graph.platform)
+          << "\\l";
+      addr += instruction_size(inst, graph.platform);
+    }
+    out << "\"];\n";
+
+    for (uint16_t next : block.successors) {
+      snprintf(line, sizeof(line), "  b%03X -> b%03X", start, next);
+      out << line;
+      if (block.exit != EXIT_FALL && block.exit != EXIT_CALL) {
+        out << " [label=\"" << exits[block.exit] << "\"]";
+      }
+      out << ";\n";
+    }
+    if (block.exit == EXIT_CALL) {
+      const uint16_t target = word_at(rom, block.end - 2) & 0xFFF;
+      snprintf(line, sizeof(line), "  b%03X -> b%03X [style=dashed];\n",
+               start, target);
+      out << line;
+    }
+  }
+  out << "}\n";
+}
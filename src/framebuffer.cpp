@@ -0,0 +1,60 @@
+#include "framebuffer.hpp"
+#include <cstdint>
+#include <cstring>
+
+void expand_rows(const Display &display, Resolution resolution,
+                 uint32_t first, uint32_t count, const uint32_t palette[4],
+                 uint32_t *pixels) {
+  const uint32_t scale_x = DISPLAY_WIDTH / resolution_width(resolution);
+  const uint32_t scale_y = DISPLAY_HEIGHT / resolution_height(resolution);
+  const uint32_t columns = resolution_width(resolution);
+
+  for (uint32_t row = first; row < first + count; row++) {
+    uint32_t *out = pixels + (row - first) * scale_y * DISPLAY_WIDTH;
+    for (uint32_t col = 0; col < columns; col++) {
+      const uint32_t half = col >> 6;
+      const uint32_t shift = 63 - (col & 63);
+      const uint32_t index = ((display[0][half][row] >> shift) & 1) |
+                             (((display[1][half][row] >> shift) & 1) << 1);
+      for (uint32_t copy = 0; copy < scale_x; copy++) {
+        out[col * scale_x + copy] = palette[index];
+      }
+    }
+    for (uint32_t copy = 1; copy < scale_y; copy++) {
+      memcpy(out + copy * DISPLAY_WIDTH, out, DISPLAY_WIDTH * sizeof(*out));
+    }
+  }
+}
+
+uint64_t hash_rows(const uint64_t *rows, uint32_t count, uint64_t hash) {
+  for (uint32_t row = 0; row < count; row++) {
+    for (uint32_t byte = 0; byte < 8; byte++) {
+      hash ^= (rows[row] >> (56 - 8 * byte)) & 0xFF;
+      hash *= 0x100000001b3ULL;
+    }
+  }
+  return hash;
+}
+
+uint64_t hash_display(const Display &display, Resolution resolution) {
+  const uint32_t height = resolution_height(resolution);
+  const uint32_t halves = resolution == RES_HIRES ? 2 : 1;
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (uint32_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+    uint64_t used = 0;
+    for (uint32_t half = 0; half < halves; half++) {
+      for (uint32_t row = 0; row < height; row++) {
+        used |= display[plane][half][row];
+      }
+    }
+    // Planes past the first only count once drawn to, so pictures that
+    // never use them hash the same as they always did
+    if (plane > 0 && used == 0) {
+      continue;
+    }
+    for (uint32_t half = 0; half < halves; half++) {
+      hash = hash_rows(display[plane][half], height, hash);
+    }
+  }
+  return hash;
+}
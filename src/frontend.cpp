@@ -0,0 +1,366 @@
+#include "frontend.hpp"
+#include "SDL3/SDL_events.h"
+#include "SDL3/SDL_init.h"
+#include "SDL3/SDL_scancode.h"
+#include "SDL3/SDL_timer.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+// Rewind history: 10 seconds at 60Hz with a keyframe every second. Deltas
+// are usually a few hundred bytes, the arena leaves room for that plus the
+// keyframes.
+#define REWIND_FRAMES 600
+#define REWIND_KEYFRAME_INTERVAL 60
+#define REWIND_ARENA_BYTES (REWIND_FRAMES * 512 + 16 * sizeof(Snapshot))
+
+Frontend::Frontend(Chip8 &chip)
+    : chip(chip), audio(AUDIO_RING_SAMPLES),
+      rewind(REWIND_FRAMES, REWIND_KEYFRAME_INTERVAL, REWIND_ARENA_BYTES),
+      movie(nullptr), keys(0), rewinding(false), requests(0), running(false),
+      needs_redraw(true), palette(), shown(), shown_resolution(RES_LORES) {}
+
+bool Frontend::init() {
+  const config_t &config = this->chip.get_config();
+  if (this->sdl.init(config.width, config.height, config.scaling_factor) ==
+      SDL_APP_FAILURE) {
+    std::cerr << "Failed to initialize SDL" << std::endl;
+    return false;
+  }
+  this->sdl.init_audio(this->audio);
+  return true;
+}
+
+// Window thread: presents the newest published frame, uploading only the
+// rows that differ from what the window shows. Frames the window was too
+// slow for are skipped, so rows are found by comparing rather than from
+// the core's dirty rows. Nothing is presented if no row changed, unless the
+// window needs repainting.
+void Frontend::present() {
+  PROFILE_SCOPE(this->chip.get_profiler(), PROFILE_PRESENT);
+  uint64_t dirty_rows = 0;
+  if (this->frames.update()) {
+    const Frontend_frame &frame = this->frames.read_slot();
+    for (uint32_t row = 0; row < DISPLAY_HEIGHT; row++) {
+      for (uint32_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+        for (uint32_t half = 0; half < 2; half++) {
+          if (frame.display[plane][half][row] !=
+              this->shown[plane][half][row]) {
+            dirty_rows |= 1ULL << row;
+          }
+        }
+      }
+    }
+    if (frame.resolution != this->shown_resolution) {
+      dirty_rows = ~0ULL;
+    }
+    memcpy(this->shown, frame.display, sizeof(this->shown));
+    this->shown_resolution = frame.resolution;
+  }
+  if (dirty_rows == 0 && !this->needs_redraw) {
+    return;
+  }
+  this->sdl.update_screen(this->palette, this->shown, this->shown_resolution,
+                          dirty_rows);
+  this->needs_redraw = false;
+}
+
+// Records the keypad of every frame into movie from now on.
+void Frontend::record(Movie *movie) { this->movie = movie; }
+
+// Emulation thread: hands the current display to the window thread.
+void Frontend::publish() {
+  Frontend_frame &frame = this->frames.write_slot();
+  memcpy(frame.display, this->chip.get_display(), sizeof(frame.display));
+  frame.resolution = this->chip.get_resolution();
+  this->frames.publish();
+}
+
+// Emulation thread: applies what the window thread asked for since the last
+// call.
+void Frontend::handle_requests() {
+  const uint32_t requests = this->requests.exchange(0);
+  if (requests & FRONTEND_QUIT) {
+    this->chip.set_state(EmuState::QUIT);
+    return;
+  }
+  if (requests & FRONTEND_PAUSE) {
+    if (this->chip.get_state() == EmuState::RUNNING) {
+      this->chip.set_state(EmuState::PAUSED);
+      puts("Emulator Paused.");
+    } else if (this->chip.get_state() == EmuState::PAUSED) {
+      this->chip.set_state(EmuState::RUNNING);
+      puts("Emulator Resumed.");
+    }
+  }
+  if (requests & FRONTEND_TURBO) {
+    config_t config = this->chip.get_config();
+    config.turbo = !config.turbo;
+    this->chip.set_config(config);
+    puts(config.turbo ? "Turbo on." : "Turbo off.");
+  }
+}
+
+// Runs one emulated frame and records it for rewinding. While BACKSPACE is
+// held, steps back one recorded frame instead.
+void Frontend::run_frame() {
+  if (this->rewinding.load(std::memory_order_relaxed)) {
+    if (this->rewind.pop(this->scratch) &&
+        this->chip.load_state(this->scratch) && this->movie != nullptr) {
+      this->movie->truncate(this->chip.get_frame_count());
+    }
+    return;
+  }
+  this->chip.set_keys(this->keys.load(std::memory_order_relaxed));
+  if (this->movie != nullptr) {
+    this->movie->record(this->chip);
+  }
+  this->chip.run_frame(this->chip.get_config().inst_per_frame);
+  this->synth.render_frame(this->chip, this->audio);
+  this->chip.save_state(this->scratch);
+  this->rewind.push(this->scratch);
+}
+
+// Emulation thread: runs and paces the core until it quits, independent of
+// how fast the window presents.
+void Frontend::emulate() {
+  const uint64_t frame_ns = SDL_NS_PER_SECOND / 60; // 60Hz
+  uint64_t next_frame_ns = SDL_GetTicksNS();
+
+  while (true) {
+    this->handle_requests();
+    if (this->chip.get_state() == EmuState::QUIT) {
+      break;
+    }
+    const config_t &config = this->chip.get_config();
+
+    if (this->chip.get_state() == EmuState::PAUSED &&
+        !this->rewinding.load(std::memory_order_relaxed)) {
+      SDL_Delay(10);                    // Reduce CPU usage when paused
+      next_frame_ns = SDL_GetTicksNS(); // Prevent catch-up burst on resume
+      continue;
+    }
+
+    if (config.turbo) {
+      // Uncapped: run emulated frames back to back for one host frame, then
+      // publish once and pick up input.
+      const uint64_t deadline_ns = SDL_GetTicksNS() + frame_ns;
+      do {
+        this->run_frame();
+      } while (!this->rewinding.load(std::memory_order_relaxed) &&
+               this->chip.get_state() == EmuState::RUNNING &&
+               SDL_GetTicksNS() < deadline_ns);
+      this->publish();
+      next_frame_ns = SDL_GetTicksNS();
+      continue;
+    }
+
+    // One batch of instructions + one timer tick per 60Hz frame, no sleeps
+    // between individual instructions.
+    this->run_frame();
+    this->publish();
+
+    next_frame_ns += frame_ns;
+    const uint64_t now_ns = SDL_GetTicksNS();
+    if (now_ns < next_frame_ns) {
+      SDL_DelayPrecise(next_frame_ns - now_ns);
+    } else if (now_ns - next_frame_ns > 4 * frame_ns) {
+      next_frame_ns = now_ns; // Fell far behind, don't try to catch up
+    }
+  }
+  this->running.store(false);
+}
+
+// Starts the emulation thread, then polls input and presents on this one
+// until the machine quits.
+void Frontend::run() {
+  const config_t &config = this->chip.get_config();
+  this->palette[0] = config.bg_color;
+  this->palette[1] = config.fg_color;
+  this->palette[2] = config.plane2_color;
+  this->palette[3] = config.overlap_color;
+  this->sdl.clear_screen(config.bg_color);
+  this->keys.store(this->chip.get_keys());
+  this->publish();
+
+  this->running.store(true);
+  std::thread emulation(&Frontend::emulate, this);
+  while (this->running.load()) {
+    this->get_input();
+    this->present();
+    // Input is polled about once a millisecond; frames are presented as
+    // they come in, at most one per pass
+    SDL_Delay(1);
+  }
+  emulation.join();
+}
+
+void Frontend::set_key(uint8_t key, bool pressed) {
+  if (pressed) {
+    this->keys.fetch_or((uint16_t)(1 << key), std::memory_order_relaxed);
+  } else {
+    this->keys.fetch_and((uint16_t)~(1 << key), std::memory_order_relaxed);
+  }
+}
+
+void Frontend::get_input() {
+  PROFILE_SCOPE(this->chip.get_profiler(), PROFILE_INPUT);
+  SDL_Event event;
+
+  while (SDL_PollEvent(&event)) {
+    switch (event.type) {
+    case SDL_EVENT_QUIT:
+      this->requests.fetch_or(FRONTEND_QUIT);
+      return; // Exit input handling immediately on quit
+
+    case SDL_EVENT_WINDOW_EXPOSED:
+    case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED:
+      this->needs_redraw = true;
+      break;
+
+    case SDL_EVENT_KEY_DOWN:
+      switch (event.key.scancode) {
+      case SDL_SCANCODE_ESCAPE:
+        this->requests.fetch_or(FRONTEND_QUIT);
+        return;
+      case SDL_SCANCODE_SPACE: // Toggle pause/run
+        this->requests.fetch_or(FRONTEND_PAUSE);
+        break;
+      case SDL_SCANCODE_TAB: // Toggle turbo (uncapped) mode
+        if (!event.key.repeat) {
+          this->requests.fetch_or(FRONTEND_TURBO);
+        }
+        break;
+      case SDL_SCANCODE_BACKSPACE: // Rewind while held
+        this->rewinding.store(true, std::memory_order_relaxed);
+        break;
+
+      // CHIP-8 Key to QWERTY Mapping
+      case SDL_SCANCODE_1:
+        this->set_key(0x1, true);
+        break;
+      case SDL_SCANCODE_2:
+        this->set_key(0x2, true);
+        break;
+      case SDL_SCANCODE_3:
+        this->set_key(0x3, true);
+        break;
+      case SDL_SCANCODE_4:
+        this->set_key(0xC, true);
+        break; // C
+
+      case SDL_SCANCODE_Q:
+        this->set_key(0x4, true);
+        break;
+      case SDL_SCANCODE_W:
+        this->set_key(0x5, true);
+        break;
+      case SDL_SCANCODE_E:
+        this->set_key(0x6, true);
+        break;
+      case SDL_SCANCODE_R:
+        this->set_key(0xD, true);
+        break; // D
+
+      case SDL_SCANCODE_A:
+        this->set_key(0x7, true);
+        break;
+      case SDL_SCANCODE_S:
+        this->set_key(0x8, true);
+        break;
+      case SDL_SCANCODE_D:
+        this->set_key(0x9, true);
+        break;
+      case SDL_SCANCODE_F:
+        this->set_key(0xE, true);
+        break; // E
+
+      case SDL_SCANCODE_Z:
+        this->set_key(0xA, true);
+        break; // A (Mapped to Z)
+      case SDL_SCANCODE_X:
+        this->set_key(0x0, true);
+        break; // 0 (Mapped to X)
+      case SDL_SCANCODE_C:
+        this->set_key(0xB, true);
+        break; // B (Mapped to C)
+      case SDL_SCANCODE_V:
+        this->set_key(0xF, true);
+        break; // F (Mapped to V)
+      default:
+        break; // Ignore other keys
+      }
+      break;
+
+    case SDL_EVENT_KEY_UP:
+      switch (event.key.scancode) {
+      case SDL_SCANCODE_BACKSPACE:
+        this->rewinding.store(false, std::memory_order_relaxed);
+        break;
+
+      // CHIP-8 Key to QWERTY Mapping
+      case SDL_SCANCODE_1:
+        this->set_key(0x1, false);
+        break;
+      case SDL_SCANCODE_2:
+        this->set_key(0x2, false);
+        break;
+      case SDL_SCANCODE_3:
+        this->set_key(0x3, false);
+        break;
+      case SDL_SCANCODE_4:
+        this->set_key(0xC, false);
+        break;
+
+      case SDL_SCANCODE_Q:
+        this->set_key(0x4, false);
+        break;
+      case SDL_SCANCODE_W:
+        this->set_key(0x5, false);
+        break;
+      case SDL_SCANCODE_E:
+        this->set_key(0x6, false);
+        break;
+      case SDL_SCANCODE_R:
+        this->set_key(0xD, false);
+        break;
+
+      case SDL_SCANCODE_A:
+        this->set_key(0x7, false);
+        break;
+      case SDL_SCANCODE_S:
+        this->set_key(0x8, false);
+        break;
+      case SDL_SCANCODE_D:
+        this->set_key(0x9, false);
+        break;
+      case SDL_SCANCODE_F:
+        this->set_key(0xE, false);
+        break;
+
+      case SDL_SCANCODE_Z:
+        this->set_key(0xA, false);
+        break; // A
+      case SDL_SCANCODE_X:
+        this->set_key(0x0, false);
+        break; // 0
+      case SDL_SCANCODE_C:
+        this->set_key(0xB, false);
+        break; // B
+      case SDL_SCANCODE_V:
+        this->set_key(0xF, false);
+        break; // F
+      default:
+        break; // Ignore other keys
+      }
+      break;
+    default:
+      break; // Ignore other event types
+    }
+  }
+}
+
+
+Frontend::~Frontend() {}
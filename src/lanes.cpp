@@ -0,0 +1,864 @@
+#include "lanes.hpp"
+#include "framebuffer.hpp"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static_assert(MAX_LANES == 32, "Lane_bytes holds exactly 32 lanes");
+
+// One byte per lane for all 32 lanes, with the handful of operations the
+// opcodes need. Masks are 0xFF in selected lanes and 0x00 elsewhere.
+#if defined(__AVX2__)
+
+typedef __m256i Lane_bytes;
+
+static inline Lane_bytes lanes_load(const uint8_t *p) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+static inline void lanes_store(uint8_t *p, Lane_bytes a) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), a);
+}
+static inline Lane_bytes lanes_splat(uint8_t b) {
+  return _mm256_set1_epi8((char)b);
+}
+static inline Lane_bytes lanes_add(Lane_bytes a, Lane_bytes b) {
+  return _mm256_add_epi8(a, b);
+}
+static inline Lane_bytes lanes_sub(Lane_bytes a, Lane_bytes b) {
+  return _mm256_sub_epi8(a, b);
+}
+static inline Lane_bytes lanes_and(Lane_bytes a, Lane_bytes b) {
+  return _mm256_and_si256(a, b);
+}
+static inline Lane_bytes lanes_or(Lane_bytes a, Lane_bytes b) {
+  return _mm256_or_si256(a, b);
+}
+static inline Lane_bytes lanes_xor(Lane_bytes a, Lane_bytes b) {
+  return _mm256_xor_si256(a, b);
+}
+static inline Lane_bytes lanes_eq(Lane_bytes a, Lane_bytes b) {
+  return _mm256_cmpeq_epi8(a, b);
+}
+// Unsigned a > b: a - b saturates to 0 exactly when a <= b
+static inline Lane_bytes lanes_gt(Lane_bytes a, Lane_bytes b) {
+  return _mm256_xor_si256(
+      _mm256_cmpeq_epi8(_mm256_subs_epu8(a, b), _mm256_setzero_si256()),
+      _mm256_set1_epi8(-1));
+}
+static inline Lane_bytes lanes_shr1(Lane_bytes a) {
+  return _mm256_and_si256(_mm256_srli_epi16(a, 1), _mm256_set1_epi8(0x7F));
+}
+// mask ? a : b
+static inline Lane_bytes lanes_select(Lane_bytes mask, Lane_bytes a,
+                                      Lane_bytes b) {
+  return _mm256_blendv_epi8(b, a, mask);
+}
+static inline uint32_t lanes_bits(Lane_bytes mask) {
+  return (uint32_t)_mm256_movemask_epi8(mask);
+}
+// Bit n of bits to byte n: copy byte n / 8 of bits into every byte, then
+// test bit n % 8 of it.
+static inline Lane_bytes lanes_mask(uint32_t bits) {
+  const __m256i spread = _mm256_shuffle_epi8(
+      _mm256_set1_epi32((int)bits),
+      _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2,
+                       2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3));
+  const __m256i select = _mm256_set1_epi64x(0x8040201008040201LL);
+  return _mm256_cmpeq_epi8(_mm256_and_si256(spread, select), select);
+}
+
+#elif defined(__SSE2__)
+
+typedef struct {
+  __m128i lo;
+  __m128i hi;
+} Lane_bytes;
+
+#define LANES_PAIR(fn, a, b) Lane_bytes{fn((a).lo, (b).lo), fn((a).hi, (b).hi)}
+
+static inline Lane_bytes lanes_load(const uint8_t *p) {
+  return {_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)),
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16))};
+}
+static inline void lanes_store(uint8_t *p, Lane_bytes a) {
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(p), a.lo);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(p + 16), a.hi);
+}
+static inline Lane_bytes lanes_splat(uint8_t b) {
+  return {_mm_set1_epi8((char)b), _mm_set1_epi8((char)b)};
+}
+static inline Lane_bytes lanes_add(Lane_bytes a, Lane_bytes b) {
+  return LANES_PAIR(_mm_add_epi8, a, b);
+}
+static inline Lane_bytes lanes_sub(Lane_bytes a, Lane_bytes b) {
+  return LANES_PAIR(_mm_sub_epi8, a, b);
+}
+static inline Lane_bytes lanes_and(Lane_bytes a, Lane_bytes b) {
+  return LANES_PAIR(_mm_and_si128, a, b);
+}
+static inline Lane_bytes lanes_or(Lane_bytes a, Lane_bytes b) {
+  return LANES_PAIR(_mm_or_si128, a, b);
+}
+static inline Lane_bytes lanes_xor(Lane_bytes a, Lane_bytes b) {
+  return LANES_PAIR(_mm_xor_si128, a, b);
+}
+static inline Lane_bytes lanes_eq(Lane_bytes a, Lane_bytes b) {
+  return LANES_PAIR(_mm_cmpeq_epi8, a, b);
+}
+// Unsigned a > b: a - b saturates to 0 exactly when a <= b
+static inline Lane_bytes lanes_gt(Lane_bytes a, Lane_bytes b) {
+  return lanes_xor(lanes_eq(LANES_PAIR(_mm_subs_epu8, a, b), lanes_splat(0)),
+                   lanes_splat(0xFF));
+}
+static inline Lane_bytes lanes_shr1(Lane_bytes a) {
+  return {_mm_and_si128(_mm_srli_epi16(a.lo, 1), _mm_set1_epi8(0x7F)),
+          _mm_and_si128(_mm_srli_epi16(a.hi, 1), _mm_set1_epi8(0x7F))};
+}
+// mask ? a : b
+static inline Lane_bytes lanes_select(Lane_bytes mask, Lane_bytes a,
+                                      Lane_bytes b) {
+  return lanes_or(lanes_and(mask, a), LANES_PAIR(_mm_andnot_si128, mask, b));
+}
+static inline uint32_t lanes_bits(Lane_bytes mask) {
+  return (uint32_t)_mm_movemask_epi8(mask.lo) |
+         ((uint32_t)_mm_movemask_epi8(mask.hi) << 16);
+}
+// Bit n of bits to byte n, 16 lanes at a time: copy byte n / 8 of bits
+// into 8 bytes, then test bit n % 8 of it.
+static inline __m128i lanes_mask_half(uint32_t bits) {
+  const __m128i select = _mm_set1_epi64x((long long)0x8040201008040201ull);
+  const __m128i spread =
+      _mm_set_epi64x((long long)(((bits >> 8) & 0xFF) * 0x0101010101010101ull),
+                     (long long)((bits & 0xFF) * 0x0101010101010101ull));
+  return _mm_cmpeq_epi8(_mm_and_si128(spread, select), select);
+}
+static inline Lane_bytes lanes_mask(uint32_t bits) {
+  return {lanes_mask_half(bits), lanes_mask_half(bits >> 16)};
+}
+
+#else
+
+// Portable fallback, the same operations one byte at a time
+typedef struct {
+  uint8_t b[MAX_LANES];
+} Lane_bytes;
+
+#define LANES_MAP(expr)                                                        \
+  Lane_bytes out;                                                              \
+  for (uint32_t lane = 0; lane < MAX_LANES; lane++) {                          \
+    out.b[lane] = (uint8_t)(expr);                                             \
+  }                                                                            \
+  return out;
+
+static inline Lane_bytes lanes_load(const uint8_t *p) {
+  Lane_bytes out;
+  memcpy(out.b, p, MAX_LANES);
+  return out;
+}
+static inline void lanes_store(uint8_t *p, Lane_bytes a) {
+  memcpy(p, a.b, MAX_LANES);
+}
+static inline Lane_bytes lanes_splat(uint8_t b) { LANES_MAP(b) }
+static inline Lane_bytes lanes_add(Lane_bytes a, Lane_bytes b) {
+  LANES_MAP(a.b[lane] + b.b[lane])
+}
+static inline Lane_bytes lanes_sub(Lane_bytes a, Lane_bytes b) {
+  LANES_MAP(a.b[lane] - b.b[lane])
+}
+static inline Lane_bytes lanes_and(Lane_bytes a, Lane_bytes b) {
+  LANES_MAP(a.b[lane] & b.b[lane])
+}
+static inline Lane_bytes lanes_or(Lane_bytes a, Lane_bytes b) {
+  LANES_MAP(a.b[lane] | b.b[lane])
+}
+static inline Lane_bytes lanes_xor(Lane_bytes a, Lane_bytes b) {
+  LANES_MAP(a.b[lane] ^ b.b[lane])
+}
+static inline Lane_bytes lanes_eq(Lane_bytes a, Lane_bytes b) {
+  LANES_MAP(a.b[lane] == b.b[lane] ? 0xFF : 0)
+}
+static inline Lane_bytes lanes_gt(Lane_bytes a, Lane_bytes b) {
+  LANES_MAP(a.b[lane] > b.b[lane] ? 0xFF : 0)
+}
+static inline Lane_bytes lanes_shr1(Lane_bytes a) { LANES_MAP(a.b[lane] >> 1) }
+// mask ? a : b
+static inline Lane_bytes lanes_select(Lane_bytes mask, Lane_bytes a,
+                                      Lane_bytes b) {
+  LANES_MAP(mask.b[lane] ? a.b[lane] : b.b[lane])
+}
+static inline uint32_t lanes_bits(Lane_bytes mask) {
+  uint32_t bits = 0;
+  for (uint32_t lane = 0; lane < MAX_LANES; lane++) {
+    bits |= (uint32_t)(mask.b[lane] >> 7) << lane;
+  }
+  return bits;
+}
+static inline Lane_bytes lanes_mask(uint32_t bits) {
+  LANES_MAP(0u - ((bits >> lane) & 1))
+}
+
+#endif
+
+// vx >>= 1 with the shifted out bit in VF, written last like op_8XY6 (so
+// it wins when x is F).
+static inline void lanes_shift_right(uint8_t *vx, uint8_t *vf,
+                                     Lane_bytes mask) {
+  const Lane_bytes a = lanes_load(vx);
+  const Lane_bytes bit = lanes_and(a, lanes_splat(1));
+  lanes_store(vx, lanes_select(mask, lanes_shr1(a), a));
+  lanes_store(vf, lanes_select(mask, bit, lanes_load(vf)));
+}
+
+// vx <<= 1 with the shifted out bit in VF, written last like op_8XYE.
+static inline void lanes_shift_left(uint8_t *vx, uint8_t *vf,
+                                    Lane_bytes mask) {
+  const Lane_bytes a = lanes_load(vx);
+  const Lane_bytes bit =
+      lanes_and(lanes_gt(a, lanes_splat(0x7F)), lanes_splat(1));
+  lanes_store(vx, lanes_select(mask, lanes_add(a, a), a));
+  lanes_store(vf, lanes_select(mask, bit, lanes_load(vf)));
+}
+
+// Per-lane 16-bit values (pc, I). Only a few operations are needed, all
+// under a lane bitmask.
+#if defined(__AVX2__)
+
+// Lanes base..base+15 of bits as 16-bit masks
+static inline __m256i words_mask(uint32_t bits, uint32_t base) {
+  const __m256i select =
+      _mm256_setr_epi16(0x1, 0x2, 0x4, 0x8, 0x10, 0x20, 0x40, 0x80, 0x100,
+                        0x200, 0x400, 0x800, 0x1000, 0x2000, 0x4000,
+                        (short)0x8000);
+  const __m256i spread = _mm256_set1_epi16((short)(bits >> base));
+  return _mm256_cmpeq_epi16(_mm256_and_si256(spread, select), select);
+}
+// words[lane] += value for every lane in bits
+static inline void words_add(uint16_t *words, uint32_t bits, uint16_t value) {
+  for (uint32_t base = 0; base < MAX_LANES; base += 16) {
+    __m256i *p = reinterpret_cast<__m256i *>(words + base);
+    const __m256i add =
+        _mm256_and_si256(words_mask(bits, base), _mm256_set1_epi16((short)value));
+    _mm256_storeu_si256(p, _mm256_add_epi16(_mm256_loadu_si256(p), add));
+  }
+}
+// words[lane] = value for every lane in bits
+static inline void words_set(uint16_t *words, uint32_t bits, uint16_t value) {
+  for (uint32_t base = 0; base < MAX_LANES; base += 16) {
+    __m256i *p = reinterpret_cast<__m256i *>(words + base);
+    _mm256_storeu_si256(p, _mm256_blendv_epi8(_mm256_loadu_si256(p),
+                                              _mm256_set1_epi16((short)value),
+                                              words_mask(bits, base)));
+  }
+}
+// Smallest word among the lanes in bits
+static inline uint16_t words_min(const uint16_t *words, uint32_t bits) {
+  const __m256i none = _mm256_set1_epi16(-1);
+  __m256i m = none;
+  for (uint32_t base = 0; base < MAX_LANES; base += 16) {
+    const __m256i w =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words + base));
+    m = _mm256_min_epu16(m, _mm256_blendv_epi8(none, w, words_mask(bits, base)));
+  }
+  __m128i h = _mm_min_epu16(_mm256_castsi256_si128(m),
+                            _mm256_extracti128_si256(m, 1));
+  return (uint16_t)_mm_cvtsi128_si32(_mm_minpos_epu16(h));
+}
+// Lanes whose word equals value
+static inline uint32_t words_equal(const uint16_t *words, uint16_t value) {
+  const __m256i v = _mm256_set1_epi16((short)value);
+  const __m256i lo = _mm256_cmpeq_epi16(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words)), v);
+  const __m256i hi = _mm256_cmpeq_epi16(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words + 16)), v);
+  // packs interleaves 128-bit halves, the permute puts lanes back in order
+  return (uint32_t)_mm256_movemask_epi8(
+      _mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 0xD8));
+}
+
+#elif defined(__SSE2__)
+
+static inline __m128i words_mask(uint32_t bits, uint32_t base) {
+  const __m128i select =
+      _mm_setr_epi16(0x1, 0x2, 0x4, 0x8, 0x10, 0x20, 0x40, (short)0x80);
+  const __m128i spread = _mm_set1_epi16((short)((bits >> base) & 0xFF));
+  return _mm_cmpeq_epi16(_mm_and_si128(spread, select), select);
+}
+static inline void words_add(uint16_t *words, uint32_t bits, uint16_t value) {
+  for (uint32_t base = 0; base < MAX_LANES; base += 8) {
+    __m128i *p = reinterpret_cast<__m128i *>(words + base);
+    const __m128i add =
+        _mm_and_si128(words_mask(bits, base), _mm_set1_epi16((short)value));
+    _mm_storeu_si128(p, _mm_add_epi16(_mm_loadu_si128(p), add));
+  }
+}
+static inline void words_set(uint16_t *words, uint32_t bits, uint16_t value) {
+  for (uint32_t base = 0; base < MAX_LANES; base += 8) {
+    __m128i *p = reinterpret_cast<__m128i *>(words + base);
+    const __m128i mask = words_mask(bits, base);
+    _mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(mask, _mm_set1_epi16((short)value)),
+                                     _mm_andnot_si128(mask, _mm_loadu_si128(p))));
+  }
+}
+static inline uint16_t words_min(const uint16_t *words, uint32_t bits) {
+  uint16_t m = 0xFFFF;
+  for (uint32_t bits_left = bits; bits_left != 0; bits_left &= bits_left - 1) {
+    const uint16_t w = words[std::countr_zero(bits_left)];
+    m = w < m ? w : m;
+  }
+  return m;
+}
+static inline uint32_t words_equal(const uint16_t *words, uint16_t value) {
+  const __m128i v = _mm_set1_epi16((short)value);
+  uint32_t bits = 0;
+  for (uint32_t base = 0; base < MAX_LANES; base += 16) {
+    const __m128i lo = _mm_cmpeq_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(words + base)), v);
+    const __m128i hi = _mm_cmpeq_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(words + base + 8)),
+        v);
+    bits |= (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(lo, hi)) << base;
+  }
+  return bits;
+}
+
+#else
+
+static inline void words_add(uint16_t *words, uint32_t bits, uint16_t value) {
+  for (uint32_t lane = 0; lane < MAX_LANES; lane++) {
+    words[lane] += (uint16_t)(value & (0u - ((bits >> lane) & 1)));
+  }
+}
+static inline void words_set(uint16_t *words, uint32_t bits, uint16_t value) {
+  for (uint32_t lane = 0; lane < MAX_LANES; lane++) {
+    if ((bits >> lane) & 1) {
+      words[lane] = value;
+    }
+  }
+}
+static inline uint16_t words_min(const uint16_t *words, uint32_t bits) {
+  uint16_t m = 0xFFFF;
+  for (uint32_t lane = 0; lane < MAX_LANES; lane++) {
+    if (((bits >> lane) & 1) && words[lane] < m) {
+      m = words[lane];
+    }
+  }
+  return m;
+}
+static inline uint32_t words_equal(const uint16_t *words, uint16_t value) {
+  uint32_t bits = 0;
+  for (uint32_t lane = 0; lane < MAX_LANES; lane++) {
+    bits |= (uint32_t)(words[lane] == value) << lane;
+  }
+  return bits;
+}
+
+#endif
+
+bool Chip8_lanes::supports(const config_t &config) {
+  return config.timing == TIMING_INSTRUCTIONS && config.quirks == 0 &&
+         config.platform == PLATFORM_CHIP8;
+}
+
+Chip8_lanes::Chip8_lanes(uint32_t lanes, const config_t &config)
+    : lanes(lanes < MAX_LANES ? lanes : MAX_LANES), config(config),
+      supported(supports(config)) {
+  memset(this->gpr, 0, sizeof(this->gpr));
+  memset(this->delay, 0, sizeof(this->delay));
+  memset(this->sound, 0, sizeof(this->sound));
+  memset(this->is_sound_active, 0, sizeof(this->is_sound_active));
+  memset(this->sp, 0, sizeof(this->sp));
+  memset(this->pc, 0, sizeof(this->pc));
+  memset(this->i, 0, sizeof(this->i));
+  memset(this->stack, 0, sizeof(this->stack));
+  memset(this->keys, 0, sizeof(this->keys));
+  memset(this->fetched, 0, sizeof(this->fetched));
+  memset(this->left, 0, sizeof(this->left));
+  this->running = 0;
+  memset(this->cycle_count, 0, sizeof(this->cycle_count));
+  memset(this->frame_count, 0, sizeof(this->frame_count));
+  memset(this->shared, 0, sizeof(this->shared));
+  this->has_shared = false;
+  memset(this->shared_diff, 0, sizeof(this->shared_diff));
+  memset(this->mem, 0, sizeof(this->mem));
+  memset(this->display, 0, sizeof(this->display));
+  for (uint32_t lane = 0; lane < MAX_LANES; lane++) {
+    this->seed(lane, 0);
+    this->state[lane] = EmuState::QUIT; // idle until a state is loaded
+  }
+}
+
+bool Chip8_lanes::ok() const { return this->supported; }
+
+uint32_t Chip8_lanes::size() const { return this->lanes; }
+
+// Runs every running lane for up to budget instructions.
+void Chip8_lanes::run_budget(uint16_t budget) {
+  words_set(this->left, ~0u, budget);
+  while (true) {
+    const uint32_t live = this->running & ~words_equal(this->left, 0);
+    if (live == 0) {
+      break;
+    }
+    // Usually every lane is at the same pc; otherwise the lowest pc goes
+    // first so the lanes behind catch up
+    uint16_t pc = this->pc[std::countr_zero(live)];
+    uint32_t group = words_equal(this->pc, pc) & live;
+    if (group != live) {
+      pc = words_min(this->pc, live);
+      group = words_equal(this->pc, pc) & live;
+    }
+    this->run_at(pc, group);
+  }
+  for (uint32_t lane = 0; lane < this->lanes; lane++) {
+    this->cycle_count[lane] += budget - this->left[lane];
+  }
+}
+
+// Runs the instruction at pc on the lanes in group, which are all at pc.
+// Mirrors Chip8::cycle().
+void Chip8_lanes::run_at(uint16_t pc, uint32_t group) {
+  if ((size_t)pc + 1 >= LANE_MEM_SIZE) {
+    for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+      this->set_state(std::countr_zero(bits), EmuState::PAUSED);
+    }
+    return;
+  }
+  words_add(this->left, group, 0xFFFF); // - 1
+  words_add(this->pc, group, 2);
+
+  // Code nobody in the group has modified: one fetch for all of them
+  if (((this->shared_diff[pc >> 6] | this->shared_diff[(pc + 1) >> 6]) &
+       group) == 0) {
+    this->execute(Chip8::split((this->shared[pc] << 8) | this->shared[pc + 1]),
+                  group);
+    return;
+  }
+
+  for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+    const uint32_t lane = std::countr_zero(bits);
+    this->fetched[lane] = (this->mem[lane][pc] << 8) | this->mem[lane][pc + 1];
+  }
+  while (group != 0) {
+    const uint16_t inst = this->fetched[std::countr_zero(group)];
+    const uint32_t same = words_equal(this->fetched, inst) & group;
+    this->execute(Chip8::split(inst), same);
+    group &= ~same;
+  }
+}
+
+// Runs op on the lanes in group. Mirrors Chip8::decode() and the op_*
+// handlers for plain CHIP-8; pc has already been advanced.
+void Chip8_lanes::execute(const Instruction &op, uint32_t group) {
+  const Lane_bytes mask = lanes_mask(group);
+  uint8_t *vx = this->gpr[op.x];
+  uint8_t *vy = this->gpr[op.y];
+  uint8_t *vf = this->gpr[0xF];
+
+  switch ((op.inst >> 12) & 0x0F) {
+  case 0x00:
+    if (op.nn == 0xE0) {
+      for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+        memset(this->display[std::countr_zero(bits)], 0,
+               sizeof(this->display[0]));
+      }
+    } else if (op.nn == 0xEE) {
+      for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+        const uint32_t lane = std::countr_zero(bits);
+        if (this->sp[lane] > 0) {
+          this->sp[lane]--;
+          this->pc[lane] = this->stack[this->sp[lane]][lane];
+        } else {
+          this->set_state(lane, EmuState::PAUSED);
+        }
+      }
+    }
+    break;
+  case 0x01:
+    words_set(this->pc, group, op.nnn);
+    break;
+  case 0x02:
+    for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+      const uint32_t lane = std::countr_zero(bits);
+      if (this->sp[lane] < (sizeof(this->stack) / sizeof(this->stack[0])) - 1) {
+        this->stack[this->sp[lane]][lane] = this->pc[lane];
+        this->sp[lane]++;
+        this->pc[lane] = op.nnn;
+      } else {
+        this->set_state(lane, EmuState::PAUSED);
+      }
+    }
+    break;
+  case 0x03:
+  case 0x04:
+  case 0x05:
+  case 0x09: {
+    // Skips: work out which lanes skip, then move just their pc
+    const Lane_bytes other = ((op.inst >> 12) == 0x03 || (op.inst >> 12) == 0x04)
+                                 ? lanes_splat(op.nn)
+                                 : lanes_load(vy);
+    const uint32_t equal = lanes_bits(lanes_eq(lanes_load(vx), other));
+    const uint32_t skip =
+        group & ((op.inst >> 12) == 0x03 || (op.inst >> 12) == 0x05 ? equal
+                                                                     : ~equal);
+    words_add(this->pc, skip, 2);
+    break;
+  }
+  case 0x06:
+    lanes_store(vx, lanes_select(mask, lanes_splat(op.nn), lanes_load(vx)));
+    break;
+  case 0x07: {
+    const Lane_bytes a = lanes_load(vx);
+    lanes_store(vx, lanes_select(mask, lanes_add(a, lanes_splat(op.nn)), a));
+    break;
+  }
+  case 0x08: {
+    const Lane_bytes a = lanes_load(vx);
+    const Lane_bytes b = lanes_load(vy);
+    switch (op.n) {
+    case 0x0:
+      lanes_store(vx, lanes_select(mask, b, a));
+      break;
+    case 0x1:
+      lanes_store(vx, lanes_select(mask, lanes_or(a, b), a));
+      break;
+    case 0x2:
+      lanes_store(vx, lanes_select(mask, lanes_and(a, b), a));
+      break;
+    case 0x3:
+      lanes_store(vx, lanes_select(mask, lanes_xor(a, b), a));
+      break;
+    case 0x4: {
+      // Carry out of the add iff the sum wrapped below a
+      const Lane_bytes sum = lanes_add(a, b);
+      lanes_store(vx, lanes_select(mask, sum, a));
+      lanes_store(vf, lanes_select(mask,
+                                   lanes_and(lanes_gt(a, sum), lanes_splat(1)),
+                                   lanes_load(vf)));
+      break;
+    }
+    case 0x5: {
+      // No borrow iff a >= b; VF last, same as op_8XY5
+      const Lane_bytes no_borrow =
+          lanes_select(lanes_gt(b, a), lanes_splat(0), lanes_splat(1));
+      lanes_store(vx, lanes_select(mask, lanes_sub(a, b), a));
+      lanes_store(vf, lanes_select(mask, no_borrow, lanes_load(vf)));
+      break;
+    }
+    case 0x6:
+      lanes_shift_right(vx, vf, mask);
+      break;
+    case 0x7: {
+      // Same as op_8XY7: reversed subtraction, then the flag
+      const Lane_bytes no_borrow =
+          lanes_select(lanes_gt(a, b), lanes_splat(0), lanes_splat(1));
+      lanes_store(vx, lanes_select(mask, lanes_sub(b, a), a));
+      lanes_store(vf, lanes_select(mask, no_borrow, lanes_load(vf)));
+      break;
+    }
+    case 0xE:
+      lanes_shift_left(vx, vf, mask);
+      break;
+    default:
+      break;
+    }
+    break;
+  }
+  case 0x0A:
+    words_set(this->i, group, op.nnn);
+    break;
+  case 0x0B:
+    for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+      const uint32_t lane = std::countr_zero(bits);
+      this->pc[lane] = op.nnn + this->gpr[0][lane];
+    }
+    break;
+  case 0x0C:
+    for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+      const uint32_t lane = std::countr_zero(bits);
+      uint32_t x = this->rng_state[lane];
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      this->rng_state[lane] = x;
+      vx[lane] = (uint8_t)(x >> 24) & op.nn;
+    }
+    break;
+  case 0x0D:
+    for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+      this->op_DXYN(std::countr_zero(bits), op);
+    }
+    break;
+  case 0x0E:
+    if (op.nn == 0x9E || op.nn == 0xA1) {
+      uint32_t down = 0;
+      for (uint32_t lane = 0; lane < MAX_LANES; lane++) {
+        down |= (uint32_t)((this->keys[lane] >> (vx[lane] & 0xF)) & 1) << lane;
+      }
+      words_add(this->pc, group & (op.nn == 0x9E ? down : ~down), 2);
+    }
+    break;
+  default: // 0x0F
+    switch (op.nn) {
+    case 0x07:
+      lanes_store(vx, lanes_select(mask, lanes_load(this->delay),
+                                   lanes_load(vx)));
+      break;
+    case 0x0A:
+      for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+        const uint32_t lane = std::countr_zero(bits);
+        if (this->keys[lane] != 0) {
+          vx[lane] = (uint8_t)std::countr_zero(this->keys[lane]);
+        } else {
+          this->pc[lane] -= 2;
+        }
+      }
+      break;
+    case 0x15:
+      lanes_store(this->delay, lanes_select(mask, lanes_load(vx),
+                                            lanes_load(this->delay)));
+      break;
+    case 0x18:
+      lanes_store(this->sound, lanes_select(mask, lanes_load(vx),
+                                            lanes_load(this->sound)));
+      break;
+    case 0x1E:
+      for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+        const uint32_t lane = std::countr_zero(bits);
+        this->i[lane] += vx[lane];
+      }
+      break;
+    case 0x29:
+      for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+        const uint32_t lane = std::countr_zero(bits);
+        this->i[lane] = (vx[lane] & 0xF) * 5 + 0x050;
+      }
+      break;
+    case 0x33:
+      // Hundreds first, same as op_FX33
+      for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+        const uint32_t lane = std::countr_zero(bits);
+        const uint8_t num = vx[lane];
+        this->write_mem(lane, this->i[lane], num / 100);
+        this->write_mem(lane, this->i[lane] + 1, num / 10 % 10);
+        this->write_mem(lane, this->i[lane] + 2, num % 10);
+      }
+      break;
+    case 0x55:
+      for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+        const uint32_t lane = std::countr_zero(bits);
+        for (uint8_t offset = 0; offset <= op.x; offset++) {
+          this->write_mem(lane, this->i[lane] + offset, this->gpr[offset][lane]);
+        }
+      }
+      break;
+    case 0x65:
+      // Reads past the end of memory give 0
+      for (uint32_t bits = group; bits != 0; bits &= bits - 1) {
+        const uint32_t lane = std::countr_zero(bits);
+        for (uint8_t offset = 0; offset <= op.x; offset++) {
+          const size_t addr = (size_t)this->i[lane] + offset;
+          this->gpr[offset][lane] =
+              addr < LANE_MEM_SIZE ? this->mem[lane][addr] : 0;
+        }
+      }
+      break;
+    default:
+      break;
+    }
+    break;
+  }
+}
+
+// Same as Chip8::write_mem(), for one lane. Keeps shared_diff up to date.
+void Chip8_lanes::write_mem(uint32_t lane, uint16_t addr, uint8_t value) {
+  if (addr >= LANE_MEM_SIZE) {
+    return;
+  }
+  this->mem[lane][addr] = value;
+  if (value != this->shared[addr]) {
+    this->shared_diff[addr >> 6] |= 1u << lane;
+  }
+}
+
+// Same as Chip8::op_DXYN, for one lane.
+void Chip8_lanes::op_DXYN(uint32_t lane, const Instruction &op) {
+  uint8_t x = this->gpr[op.x][lane] % 64;
+  uint8_t y = this->gpr[op.y][lane] % 32;
+  uint64_t *display = this->display[lane];
+
+  // Columns past config.width are clipped
+  const uint64_t clip =
+      this->config.width >= 64 ? ~0ULL : ~(~0ULL >> this->config.width);
+
+  this->gpr[0xF][lane] = 0;
+
+  for (uint8_t row = 0; row < op.n; row++) {
+    if ((size_t)this->i[lane] + row >= LANE_MEM_SIZE) {
+      break;
+    }
+    uint8_t curr_y = y + row;
+    if (curr_y >= this->config.height) {
+      break;
+    }
+
+    const uint64_t sprite_byte = this->mem[lane][this->i[lane] + row];
+    const uint64_t bits =
+        (x <= 56 ? sprite_byte << (56 - x) : sprite_byte >> (x - 56)) & clip;
+
+    if (display[curr_y] & bits) {
+      this->gpr[0xF][lane] = 1;
+    }
+    display[curr_y] ^= bits;
+  }
+}
+
+// Ticks delay/sound on every lane, same as Chip8::update_timers().
+void Chip8_lanes::update_timers() {
+  const Lane_bytes one = lanes_splat(1);
+  const Lane_bytes zero = lanes_splat(0);
+
+  const Lane_bytes delay = lanes_load(this->delay);
+  lanes_store(this->delay,
+              lanes_select(lanes_eq(delay, zero), delay, lanes_sub(delay, one)));
+
+  // The beep stays on while the timer is still nonzero after the tick
+  const Lane_bytes sound = lanes_load(this->sound);
+  lanes_store(this->is_sound_active, lanes_and(lanes_gt(sound, one), one));
+  lanes_store(this->sound,
+              lanes_select(lanes_eq(sound, zero), sound, lanes_sub(sound, one)));
+}
+
+// One 60Hz frame on every lane, same as Chip8::run_frame().
+void Chip8_lanes::run_frame(uint32_t inst_per_frame) {
+  while (inst_per_frame > 0) {
+    const uint16_t budget = inst_per_frame < 0xFFFF ? inst_per_frame : 0xFFFF;
+    this->run_budget(budget);
+    inst_per_frame -= budget;
+  }
+  this->update_timers();
+  for (uint32_t lane = 0; lane < this->lanes; lane++) {
+    this->frame_count[lane]++;
+  }
+}
+
+// Only plain CHIP-8 states load, and only if the config was supported: no
+// VIP timing, 64x32 on one plane, and fewer than 12 stack entries.
+bool Chip8_lanes::load_state(uint32_t lane, const Snapshot &snapshot) {
+  if (!this->supported || lane >= this->lanes ||
+      snapshot.magic != SNAPSHOT_MAGIC ||
+      snapshot.version != SNAPSHOT_VERSION ||
+      snapshot.platform != PLATFORM_CHIP8 ||
+      snapshot.mem_size != LANE_MEM_SIZE || snapshot.machine_cycles != 0 ||
+      snapshot.cycle_debt != 0 || snapshot.resolution != RES_LORES ||
+      snapshot.planes != 1 || snapshot.sp >= 12) {
+    return false;
+  }
+  memcpy(this->mem[lane], snapshot.mem, LANE_MEM_SIZE);
+  if (!this->has_shared) {
+    memcpy(this->shared, snapshot.mem, sizeof(this->shared));
+    this->has_shared = true;
+  }
+  for (uint32_t chunk = 0; chunk < LANE_MEM_SIZE / 64; chunk++) {
+    const bool differs =
+        memcmp(snapshot.mem + chunk * 64, this->shared + chunk * 64, 64) != 0;
+    this->shared_diff[chunk] =
+        (this->shared_diff[chunk] & ~(1u << lane)) | ((uint32_t)differs << lane);
+  }
+  memcpy(this->display[lane], snapshot.display[0][0],
+         sizeof(this->display[lane]));
+  for (uint32_t slot = 0; slot < 12; slot++) {
+    this->stack[slot][lane] = snapshot.stack[slot];
+  }
+  this->pc[lane] = snapshot.pc;
+  this->i[lane] = snapshot.i;
+  for (uint32_t x = 0; x < 16; x++) {
+    this->gpr[x][lane] = snapshot.gpr[x];
+  }
+  this->sp[lane] = snapshot.sp;
+  this->delay[lane] = snapshot.delay;
+  this->sound[lane] = snapshot.sound;
+  this->keys[lane] = snapshot.keypad;
+  this->is_sound_active[lane] = snapshot.is_sound_active;
+  this->rng_state[lane] = snapshot.rng_state;
+  this->cycle_count[lane] = snapshot.cycle_count;
+  this->frame_count[lane] = snapshot.frame_count;
+  this->set_state(lane, (EmuState)snapshot.state);
+  return true;
+}
+
+void Chip8_lanes::save_state(uint32_t lane, Snapshot &snapshot) const {
+  snapshot.magic = SNAPSHOT_MAGIC;
+  snapshot.version = SNAPSHOT_VERSION;
+  snapshot.platform = PLATFORM_CHIP8;
+  snapshot.mem_size = LANE_MEM_SIZE;
+  memcpy(snapshot.mem, this->mem[lane], LANE_MEM_SIZE);
+  memset(snapshot.display, 0, sizeof(snapshot.display));
+  memcpy(snapshot.display[0][0], this->display[lane],
+         sizeof(this->display[lane]));
+  memset(snapshot.stack, 0, sizeof(snapshot.stack));
+  for (uint32_t slot = 0; slot < 12; slot++) {
+    snapshot.stack[slot] = this->stack[slot][lane];
+  }
+  snapshot.pc = this->pc[lane];
+  snapshot.i = this->i[lane];
+  for (uint32_t x = 0; x < 16; x++) {
+    snapshot.gpr[x] = this->gpr[x][lane];
+  }
+  snapshot.sp = this->sp[lane];
+  snapshot.delay = this->delay[lane];
+  snapshot.sound = this->sound[lane];
+  snapshot.state = (uint8_t)this->state[lane];
+  snapshot.keypad = this->keys[lane];
+  snapshot.is_sound_active = this->is_sound_active[lane];
+  snapshot.resolution = RES_LORES;
+  snapshot.rng_state = this->rng_state[lane];
+  snapshot.cycle_count = this->cycle_count[lane];
+  snapshot.frame_count = this->frame_count[lane];
+  snapshot.machine_cycles = 0;
+  snapshot.cycle_debt = 0;
+  snapshot.planes = 1;
+  snapshot.pitch = 64;
+  memset(snapshot.reserved, 0, sizeof(snapshot.reserved));
+  memset(snapshot.rpl, 0, sizeof(snapshot.rpl));
+  memset(snapshot.pattern, 0, sizeof(snapshot.pattern));
+}
+
+void Chip8_lanes::seed(uint32_t lane, uint32_t seed) {
+  this->rng_state[lane] = seed != 0 ? seed : 0x9E3779B9;
+}
+
+void Chip8_lanes::set_keys(uint32_t lane, uint16_t keys) {
+  this->keys[lane] = keys;
+}
+
+EmuState Chip8_lanes::get_state(uint32_t lane) const {
+  return this->state[lane];
+}
+
+void Chip8_lanes::set_state(uint32_t lane, EmuState state) {
+  this->state[lane] = state;
+  if (state == EmuState::RUNNING && lane < this->lanes) {
+    this->running |= 1u << lane;
+  } else {
+    this->running &= ~(1u << lane);
+  }
+}
+
+uint64_t Chip8_lanes::get_cycle_count(uint32_t lane) const {
+  return this->cycle_count[lane];
+}
+
+uint64_t Chip8_lanes::get_frame_count(uint32_t lane) const {
+  return this->frame_count[lane];
+}
+
+uint64_t Chip8_lanes::display_hash(uint32_t lane) const {
+  return hash_rows(this->display[lane], 32);
+}
@@ -1,12 +1,114 @@
 #include "chip8.hpp"
+#include "frontend.hpp"
+#include "movie.hpp"
+#include "quirks.hpp"
+#include "rom.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <iostream>
+#include <memory>
 
 int main(int argc, char**argv) {
-  if(argc < 2) {
-    std::cerr<<"Usage --- chip8 <path-to-rom>"<<std::endl;
+  char *rom_path = nullptr;
+  bool turbo = false;
+  long inst_per_frame = 0;
+  Timing timing = TIMING_INSTRUCTIONS;
+  const char *quirks_name = "auto";
+  const char *record_path = nullptr;
+  const char *profile_path = nullptr;
+  uint32_t seed = (uint32_t)std::time(NULL);
+
+  for (int arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "--turbo") == 0) {
+      turbo = true;
+    } else if (strcmp(argv[arg], "--ipf") == 0 && arg + 1 < argc) {
+      inst_per_frame = std::strtol(argv[++arg], nullptr, 10);
+    } else if (strcmp(argv[arg], "--quirks") == 0 && arg + 1 < argc) {
+      quirks_name = argv[++arg];
+    } else if (strcmp(argv[arg], "--timing") == 0 && arg + 1 < argc) {
+      arg++;
+      if (strcmp(argv[arg], "vip") == 0) {
+        timing = TIMING_VIP;
+      } else {
+        timing = TIMING_INSTRUCTIONS;
+      }
+    } else if (strcmp(argv[arg], "--profile") == 0 && arg + 1 < argc) {
+      profile_path = argv[++arg];
+    } else if (strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc) {
+      seed = (uint32_t)std::strtoul(argv[++arg], nullptr, 0);
+    } else if (strcmp(argv[arg], "--record") == 0 && arg + 1 < argc) {
+      record_path = argv[++arg];
+    } else {
+      rom_path = argv[arg];
+    }
+  }
+
+  if(rom_path == nullptr) {
+    std::cerr<<"Usage --- chip8 [--turbo] [--ipf <inst-per-frame>] [--timing instructions|vip] [--quirks auto|default|chip8|chip8hires|schip|xochip] [--seed <n>] [--record <movie>] [--profile <prefix>] <path-to-rom>"<<std::endl;
+    return 1;
+  }
+  Rom_file rom(rom_path);
+  if (rom.get() == nullptr) {
+    std::cerr << "Can't load ROM " << rom_path << ": " << rom.why_not()
+              << std::endl;
+    return 1;
+  }
+  // A machine is a couple of MB with the 64 KB decode caches, too much for
+  // some default stacks
+  auto machine = std::make_unique<Chip8>(*rom.get());
+  Chip8 &chip = *machine;
+
+  config_t config = chip.get_config();
+  config.turbo = turbo;
+  config.timing = timing;
+
+  // Known ROMs get the machine they were written for unless told otherwise
+  Profile profile = rom_profile(chip.get_rom_hash());
+  if (strcmp(quirks_name, "auto") != 0 &&
+      !parse_profile(quirks_name, profile)) {
+    std::cerr << "Unknown quirks profile " << quirks_name << std::endl;
+    return 1;
+  }
+  config.quirks = profile_quirks(profile);
+  config.platform = profile_platform(profile);
+  if (inst_per_frame > 0) {
+    config.inst_per_frame = (uint32_t)inst_per_frame;
+  }
+  chip.set_config(config);
+  chip.seed(seed);
+
+  Profiler profiler;
+  if (profile_path != nullptr) {
+#ifndef CHIP8_PROFILE
+    std::cerr << "Built without CHIP8_PROFILE, the profile will be empty"
+              << std::endl;
+#endif
+    chip.set_profiler(&profiler);
+  }
+
+  Movie movie;
+  Frontend frontend(chip);
+  if (!frontend.init()) {
+    return 1;
+  }
+  if (record_path != nullptr) {
+    movie.start(chip, seed);
+    frontend.record(&movie);
+  }
+  frontend.run();
+
+  if (record_path != nullptr) {
+    movie.finish(chip);
+    if (!movie.save(record_path)) {
+      std::cerr << "Can't save movie to " << record_path << std::endl;
+      return 1;
+    }
+  }
+  if (profile_path != nullptr && !save_profile(profile_path, profiler)) {
+    std::cerr << "Can't save profile to " << profile_path << std::endl;
     return 1;
   }
-  Chip8 chip(argv[1]);
-  chip.run();
   return 0;
 }
@@ -0,0 +1,389 @@
+#include "chip8.hpp"
+#include "framebuffer.hpp"
+#include "lanes.hpp"
+#include "movie.hpp"
+#include "quirks.hpp"
+#include "rom.hpp"
+#include "work_pool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Runs many headless machines across all cores. Every job owns its Chip8
+// (or its lane of a Chip8_lanes) and Movie; nothing mutable is shared
+// between pool jobs except the result slots they write.
+
+// One manifest line: <rom> TAB <seed> TAB <movie or -> TAB <frames>.
+// frames 0 means "as long as the movie", or 600 without one.
+typedef struct {
+  std::string rom;
+  uint32_t seed;
+  std::string movie;
+  uint64_t frames;
+} Batch_job;
+
+typedef struct {
+  uint64_t frames;
+  uint64_t cycles;
+  uint64_t display_hash;
+  uint64_t state_hash;
+  const char *halt; // why the job stopped
+} Batch_result;
+
+static bool parse_manifest(const char *path, std::vector<Batch_job> &jobs) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::string line;
+  uint32_t line_number = 0;
+  while (std::getline(file, line)) {
+    line_number++;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, '\t')) {
+      fields.push_back(field);
+    }
+    if (fields.size() != 4) {
+      std::cerr << path << ":" << line_number
+                << ": expected rom<TAB>seed<TAB>movie<TAB>frames" << std::endl;
+      return false;
+    }
+    Batch_job job;
+    job.rom = fields[0];
+    job.seed = (uint32_t)std::strtoul(fields[1].c_str(), nullptr, 0);
+    job.movie = fields[2] == "-" ? "" : fields[2];
+    job.frames = std::strtoull(fields[3].c_str(), nullptr, 10);
+    jobs.push_back(job);
+  }
+  return true;
+}
+
+// A manifest rom is a path, or hash:<hex> for a ROM in the --library
+// catalog. Either way it is mapped once and shared by every job using it.
+static const Rom *resolve_rom(Rom_library &library, const std::string &rom) {
+  if (rom.rfind("hash:", 0) == 0) {
+    return library.find(std::strtoull(rom.c_str() + 5, nullptr, 16));
+  }
+  return library.load(rom);
+}
+
+static const char *platform_name(Platform platform) {
+  static const char *names[] = {"chip8", "chip8hires", "schip", "xochip"};
+  return names[platform];
+}
+
+// A job ready to run: its machine at power-on, seeded, with its movie.
+typedef struct {
+  std::unique_ptr<Chip8> chip;
+  Movie movie;
+  bool has_movie;
+  uint64_t frames;
+} Batch_machine;
+
+// Sets up job in machine, with the quirks of profile or, if that is
+// nullptr, of the ROM's entry in the database. Returns why it can't run, or
+// nullptr.
+static const char *prepare_job(const Batch_job &job, Rom_library &library,
+                               Backend backend, const Profile *profile,
+                               Batch_machine &machine) {
+  const Rom *rom = resolve_rom(library, job.rom);
+  if (rom == nullptr) {
+    return "bad_rom";
+  }
+
+  machine.chip = std::make_unique<Chip8>(*rom);
+  config_t config = machine.chip->get_config();
+  config.backend = backend;
+  const uint64_t rom_hash = machine.chip->get_rom_hash();
+  const Profile machine_profile =
+      profile != nullptr ? *profile : rom_profile(rom_hash);
+  config.quirks = profile_quirks(machine_profile);
+  config.platform = profile_platform(machine_profile);
+  machine.chip->seed(job.seed);
+
+  machine.frames = job.frames != 0 ? job.frames : 600;
+  machine.has_movie = !job.movie.empty();
+  if (machine.has_movie) {
+    if (!machine.movie.load(job.movie.c_str())) {
+      return "bad_movie";
+    }
+    const Movie_header &header = machine.movie.get_header();
+    if (header.rom_hash != machine.chip->get_rom_hash()) {
+      return "movie_rom_mismatch";
+    }
+    machine.chip->seed(header.seed);
+    config.inst_per_frame = header.inst_per_frame;
+    config.timing = (Timing)header.timing;
+    config.cycles_per_frame = header.cycles_per_frame;
+    config.quirks = header.quirks;
+    config.platform = (Platform)header.platform;
+    if (job.frames == 0) {
+      machine.frames = header.frames;
+    }
+  }
+  machine.chip->set_config(config);
+  return nullptr;
+}
+
+static Batch_result result_of(const Snapshot &snapshot) {
+  Batch_result result;
+  result.frames = snapshot.frame_count;
+  result.cycles = snapshot.cycle_count;
+  result.display_hash =
+      hash_display(snapshot.display, (Resolution)snapshot.resolution);
+  result.state_hash = snapshot_hash(snapshot);
+  result.halt = snapshot.state != EmuState::RUNNING ? "halted" : "frames";
+  return result;
+}
+
+static Batch_result run_machine(Batch_machine &machine) {
+  Chip8 &chip = *machine.chip;
+  const uint32_t inst_per_frame = chip.get_config().inst_per_frame;
+
+  while (chip.get_frame_count() < machine.frames &&
+         chip.get_state() == EmuState::RUNNING) {
+    if (machine.has_movie) {
+      machine.movie.play(chip);
+    }
+    chip.run_frame(inst_per_frame);
+  }
+
+  Snapshot snapshot;
+  chip.save_state(snapshot);
+  return result_of(snapshot);
+}
+
+static Batch_result run_job(const Batch_job &job, Rom_library &library,
+                            Backend backend, const Profile *profile) {
+  Batch_machine machine;
+  if (const char *error =
+          prepare_job(job, library, backend, profile, machine)) {
+    return {0, 0, 0, 0, error};
+  }
+  return run_machine(machine);
+}
+
+// Runs jobs of the same ROM side by side in one Chip8_lanes. Each lane
+// stops when its job would have, so results match run_job(). Jobs with VIP
+// timing, quirks or another platform than CHIP-8, which the lanes core
+// doesn't model, run on their own on backend.
+static void run_lanes(const std::vector<Batch_job> &jobs,
+                      const std::vector<size_t> &batch, Rom_library &library,
+                      Backend backend, const Profile *profile,
+                      std::vector<Batch_result> &results) {
+  std::vector<Batch_machine> machines(batch.size());
+  std::vector<size_t> ready;
+  for (size_t n = 0; n < batch.size(); n++) {
+    if (const char *error = prepare_job(jobs[batch[n]], library, backend,
+                                        profile, machines[n])) {
+      results[batch[n]] = {0, 0, 0, 0, error};
+    } else if (!Chip8_lanes::supports(machines[n].chip->get_config())) {
+      results[batch[n]] = run_machine(machines[n]);
+    } else {
+      ready.push_back(n);
+    }
+  }
+
+  // Movies can change the instructions per frame; lanes share one
+  while (!ready.empty()) {
+    const config_t config = machines[ready[0]].chip->get_config();
+    std::vector<size_t> group;
+    std::vector<size_t> rest;
+    for (size_t n : ready) {
+      const config_t &other = machines[n].chip->get_config();
+      const bool same = other.inst_per_frame == config.inst_per_frame;
+      (same ? group : rest).push_back(n);
+    }
+    ready.swap(rest);
+
+    auto lanes = std::make_unique<Chip8_lanes>((uint32_t)group.size(), config);
+    Snapshot snapshot;
+    for (uint32_t lane = 0; lane < group.size(); lane++) {
+      machines[group[lane]].chip->save_state(snapshot);
+      lanes->load_state(lane, snapshot);
+      machines[group[lane]].chip.reset();
+    }
+
+    size_t unfinished = group.size();
+    std::vector<bool> finished(group.size(), false);
+    while (true) {
+      for (uint32_t lane = 0; lane < group.size(); lane++) {
+        if (finished[lane] ||
+            (lanes->get_frame_count(lane) < machines[group[lane]].frames &&
+             lanes->get_state(lane) == EmuState::RUNNING)) {
+          continue;
+        }
+        lanes->save_state(lane, snapshot);
+        results[batch[group[lane]]] = result_of(snapshot);
+        lanes->set_state(lane, EmuState::QUIT);
+        finished[lane] = true;
+        unfinished--;
+      }
+      if (unfinished == 0) {
+        break;
+      }
+
+      for (uint32_t lane = 0; lane < group.size(); lane++) {
+        uint16_t keys;
+        Batch_machine &machine = machines[group[lane]];
+        if (machine.has_movie &&
+            machine.movie.keys_at(lanes->get_frame_count(lane), keys)) {
+          lanes->set_keys(lane, keys);
+        }
+      }
+      lanes->run_frame(config.inst_per_frame);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *manifest_path = nullptr;
+  const char *output_path = nullptr;
+  long threads = 0;
+  long lanes = 1;
+  const char *quirks_name = "auto";
+  Backend backend = BACKEND_CACHED;
+  std::vector<const char *> library_dirs;
+  bool list = false;
+
+  for (int arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc) {
+      threads = std::strtol(argv[++arg], nullptr, 10);
+    } else if (strcmp(argv[arg], "--quirks") == 0 && arg + 1 < argc) {
+      quirks_name = argv[++arg];
+    } else if (strcmp(argv[arg], "--lanes") == 0 && arg + 1 < argc) {
+      lanes = std::min(std::strtol(argv[++arg], nullptr, 10), (long)MAX_LANES);
+    } else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+      output_path = argv[++arg];
+    } else if (strcmp(argv[arg], "--library") == 0 && arg + 1 < argc) {
+      library_dirs.push_back(argv[++arg]);
+    } else if (strcmp(argv[arg], "--list") == 0) {
+      list = true;
+    } else if (strcmp(argv[arg], "--backend") == 0 && arg + 1 < argc) {
+      arg++;
+      if (strcmp(argv[arg], "uncached") == 0) {
+        backend = BACKEND_UNCACHED;
+      } else if (strcmp(argv[arg], "recompiler") == 0) {
+        backend = BACKEND_RECOMPILER;
+      } else {
+        backend = BACKEND_CACHED;
+      }
+    } else {
+      manifest_path = argv[arg];
+    }
+  }
+
+  if (manifest_path == nullptr && !list) {
+    std::cerr << "Usage --- chip8_batch [--threads <n>] [--lanes <n>] "
+                 "[--backend uncached|cached|recompiler] "
+                 "[--quirks auto|default|chip8|chip8hires|schip|xochip] "
+                 "[--library <rom-dir>]... [-o <results>] <manifest>\n"
+                 "          chip8_batch --library <rom-dir>... --list"
+              << std::endl;
+    return 1;
+  }
+
+  Rom_library library;
+  for (const char *dir : library_dirs) {
+    if (library.scan(dir) == 0) {
+      std::cerr << "No ROMs in " << dir << std::endl;
+    }
+  }
+  if (list) {
+    // The catalog: what every ROM is by content and what it runs on
+    std::cout << "hash\tsize\tplatform\tprofile\tpath\n";
+    for (const Rom_entry &entry : library.entries()) {
+      std::cout << std::hex << entry.hash << std::dec << "\t" << entry.size
+                << "\t" << platform_name(profile_platform(entry.profile))
+                << "\t" << profile_name(entry.profile) << "\t" << entry.path
+                << "\n";
+    }
+    return 0;
+  }
+
+  Profile forced;
+  const Profile *profile = nullptr; // from the database
+  if (strcmp(quirks_name, "auto") != 0) {
+    if (!parse_profile(quirks_name, forced)) {
+      std::cerr << "Unknown quirks profile " << quirks_name << std::endl;
+      return 1;
+    }
+    profile = &forced;
+  }
+
+  std::vector<Batch_job> jobs;
+  if (!parse_manifest(manifest_path, jobs)) {
+    std::cerr << "Can't read manifest " << manifest_path << std::endl;
+    return 1;
+  }
+
+  std::vector<Batch_result> results(jobs.size());
+  Work_pool pool(threads > 0 ? (uint32_t)threads : 0);
+  auto start = std::chrono::steady_clock::now();
+  if (lanes > 1) {
+    // Up to lanes jobs of the same ROM per pool job
+    std::vector<size_t> order(jobs.size());
+    for (size_t index = 0; index < jobs.size(); index++) {
+      order[index] = index;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return jobs[a].rom < jobs[b].rom;
+    });
+    std::vector<std::vector<size_t>> batches;
+    for (size_t index : order) {
+      if (batches.empty() || batches.back().size() >= (size_t)lanes ||
+          jobs[batches.back()[0]].rom != jobs[index].rom) {
+        batches.emplace_back();
+      }
+      batches.back().push_back(index);
+    }
+    pool.run(batches.size(), [&](size_t index, uint32_t) {
+      run_lanes(jobs, batches[index], library, backend, profile, results);
+    });
+  } else {
+    pool.run(jobs.size(), [&](size_t index, uint32_t) {
+      results[index] = run_job(jobs[index], library, backend, profile);
+    });
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::ofstream file;
+  if (output_path != nullptr) {
+    file.open(output_path, std::ios::trunc);
+    if (!file) {
+      std::cerr << "Can't write results to " << output_path << std::endl;
+      return 1;
+    }
+  }
+  std::ostream &out = output_path != nullptr ? file : std::cout;
+
+  uint64_t total_cycles = 0;
+  out << "job\trom\tframes\tcycles\tdisplay_hash\tstate_hash\thalt\n";
+  for (size_t index = 0; index < jobs.size(); index++) {
+    const Batch_result &result = results[index];
+    out << index << "\t" << jobs[index].rom << "\t" << result.frames << "\t"
+        << result.cycles << "\t" << std::hex << result.display_hash << "\t"
+        << result.state_hash << std::dec << "\t" << result.halt << "\n";
+    total_cycles += result.cycles;
+  }
+  out.flush();
+
+  std::cerr << jobs.size() << " jobs on " << pool.size() << " threads in "
+            << elapsed.count() << "s, "
+            << (total_cycles / elapsed.count()) / 1e6 << " mips" << std::endl;
+  return 0;
+}
@@ -0,0 +1,399 @@
+#include "chip8.hpp"
+#include "framebuffer.hpp"
+#include "quirks.hpp"
+#include "rom.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Micro benchmarks time one kind of work in a loop: small ROM kernels for
+// dispatch and single opcodes, and the framebuffer expansion frontends
+// upload from. Macro benchmarks run real ROMs headless. Every benchmark is
+// repeated until it has run for at least --min-time seconds, and results
+// are written as JSON in the layout Google Benchmark uses, so its compare
+// tooling reads them.
+
+#define BENCH_KERNEL_IPF 10000 // instructions per run_frame() in kernels
+
+typedef struct {
+  std::string name;
+  uint64_t iterations;
+  double seconds;
+  uint64_t items;  // instructions, rows or frames, see unit
+  uint64_t frames; // emulated frames, macro benchmarks only
+  const char *unit;
+} Bench_result;
+
+// One ROM kernel: setup runs once, then body loops forever
+typedef struct {
+  const char *name;
+  Profile profile;
+  Backend backend;
+  std::vector<uint16_t> setup;
+  std::vector<uint16_t> body;
+} Bench_kernel;
+
+// Calls step until min_seconds have passed. step returns the items it did.
+template <typename Step>
+static Bench_result measure(const std::string &name, const char *unit,
+                            double min_seconds, Step step) {
+  Bench_result result = {name, 0, 0, 0, 0, unit};
+  const auto start = std::chrono::steady_clock::now();
+  do {
+    result.items += step();
+    result.iterations++;
+    result.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  } while (result.seconds < min_seconds);
+  return result;
+}
+
+static std::vector<uint16_t> repeat(std::vector<uint16_t> ops,
+                                    uint32_t times) {
+  std::vector<uint16_t> repeated;
+  for (uint32_t n = 0; n < times; n++) {
+    repeated.insert(repeated.end(), ops.begin(), ops.end());
+  }
+  return repeated;
+}
+
+static std::vector<Bench_kernel> kernels() {
+  // Sixteen register ops, the mix a game loop spends most of its time on
+  const std::vector<uint16_t> alu = {
+      0x7001, 0x8014, 0x8202, 0x3355, 0x8121, 0x7203, 0x8310, 0x4444,
+      0x8233, 0x7105, 0x8026, 0x6477, 0x8134, 0x9010, 0x7307, 0x8243,
+  };
+  std::vector<Bench_kernel> list = {
+      {"dispatch/uncached", PROFILE_DEFAULT, BACKEND_UNCACHED, {}, alu},
+      {"dispatch/cached", PROFILE_DEFAULT, BACKEND_CACHED, {}, alu},
+      {"dispatch/recompiler", PROFILE_DEFAULT, BACKEND_RECOMPILER, {}, alu},
+      // Font sprites walking across the screen, clipped and not
+      {"DXYN/lores",
+       PROFILE_DEFAULT,
+       BACKEND_CACHED,
+       {0xA050},
+       repeat({0xD015, 0x7005, 0x7103}, 8)},
+      {"DXYN/hires",
+       PROFILE_SCHIP,
+       BACKEND_CACHED,
+       {0x00FF, 0xA050},
+       repeat({0xD015, 0x7005, 0x7103}, 8)},
+      {"DXY0/hires",
+       PROFILE_SCHIP,
+       BACKEND_CACHED,
+       {0x00FF, 0xA050},
+       repeat({0xD010, 0x7009, 0x7105}, 8)},
+      {"FX33",
+       PROFILE_DEFAULT,
+       BACKEND_CACHED,
+       {0xA300},
+       repeat({0xF033, 0x7001}, 8)},
+      {"FX55",
+       PROFILE_DEFAULT,
+       BACKEND_CACHED,
+       {0xA300},
+       repeat({0xFF55}, 16)},
+      {"FX65",
+       PROFILE_DEFAULT,
+       BACKEND_CACHED,
+       {0xA300},
+       repeat({0xFF65}, 16)},
+  };
+  return list;
+}
+
+// The ROM image of a kernel: setup, body, then a jump back to the body
+static std::vector<uint8_t> kernel_image(const Bench_kernel &kernel) {
+  std::vector<uint16_t> ops = kernel.setup;
+  const uint16_t loop = (uint16_t)(ROM_ENTRY_POINT + ops.size() * 2);
+  ops.insert(ops.end(), kernel.body.begin(), kernel.body.end());
+  ops.push_back(0x1000 | loop);
+
+  std::vector<uint8_t> image;
+  for (uint16_t op : ops) {
+    image.push_back((uint8_t)(op >> 8));
+    image.push_back((uint8_t)(op & 0xFF));
+  }
+  return image;
+}
+
+// Builds a machine for rom the way chip8_headless does
+static std::unique_ptr<Chip8> boot(const Rom &rom, Profile profile,
+                                   bool auto_profile, Backend backend,
+                                   uint32_t inst_per_frame) {
+  auto chip = std::make_unique<Chip8>(rom);
+  if (auto_profile) {
+    profile = rom_profile(chip->get_rom_hash());
+  }
+  config_t config = chip->get_config();
+  config.backend = backend;
+  config.quirks = profile_quirks(profile);
+  config.platform = profile_platform(profile);
+  if (inst_per_frame > 0) {
+    config.inst_per_frame = inst_per_frame;
+  }
+  chip->set_config(config);
+  chip->seed(1);
+  return chip;
+}
+
+static void run_kernels(const std::string &filter, double min_seconds,
+                        std::vector<Bench_result> &results) {
+  for (const Bench_kernel &kernel : kernels()) {
+    if (std::string(kernel.name).find(filter) == std::string::npos) {
+      continue;
+    }
+    const std::vector<uint8_t> image = kernel_image(kernel);
+    const Rom rom = {image.data(), (uint32_t)image.size(),
+                     rom_hash(image.data(), (uint32_t)image.size())};
+    auto chip = boot(rom, kernel.profile, false, kernel.backend, 0);
+    // One untimed frame to fill the decode cache and compile blocks
+    chip->run_frame(BENCH_KERNEL_IPF);
+    results.push_back(measure(kernel.name, "instructions", min_seconds, [&]() {
+      const uint64_t before = chip->get_cycle_count();
+      chip->run_frame(BENCH_KERNEL_IPF);
+      return chip->get_cycle_count() - before;
+    }));
+  }
+}
+
+static void run_framebuffer(const std::string &filter, double min_seconds,
+                            std::vector<Bench_result> &results) {
+  // Noise in both planes, so every palette entry gets used
+  Display display;
+  uint64_t bits = 0x9E3779B97F4A7C15ULL;
+  for (auto &plane : display) {
+    for (auto &half : plane) {
+      for (uint64_t &row : half) {
+        bits ^= bits << 13;
+        bits ^= bits >> 7;
+        bits ^= bits << 17;
+        row = bits;
+      }
+    }
+  }
+  const uint32_t palette[4] = {0x000000FF, 0xFFFFFFFF, 0xAAAAAAFF,
+                               0x555555FF};
+  std::vector<uint32_t> pixels(DISPLAY_WIDTH * DISPLAY_HEIGHT);
+
+  const struct {
+    const char *name;
+    Resolution resolution;
+  } modes[] = {{"lores", RES_LORES}, {"tall", RES_TALL}, {"hires", RES_HIRES}};
+  for (const auto &mode : modes) {
+    const uint32_t height = resolution_height(mode.resolution);
+    const std::string expand = std::string("expand_rows/") + mode.name;
+    if (expand.find(filter) != std::string::npos) {
+      results.push_back(measure(expand, "rows", min_seconds, [&]() {
+        expand_rows(display, mode.resolution, 0, height, palette,
+                    pixels.data());
+        return height;
+      }));
+    }
+    const std::string hash = std::string("hash_display/") + mode.name;
+    if (hash.find(filter) != std::string::npos) {
+      // Stored so the hashing isn't optimized away
+      volatile uint64_t sink = 0;
+      results.push_back(measure(hash, "rows", min_seconds, [&]() {
+        sink = hash_display(display, mode.resolution);
+        return height;
+      }));
+    }
+  }
+}
+
+// Every .ch8 under dirs, sorted so runs line up
+static std::vector<std::string> find_roms(const std::vector<std::string> &dirs) {
+  std::vector<std::string> roms;
+  for (const std::string &dir : dirs) {
+    std::error_code error;
+    for (const auto &entry :
+         std::filesystem::directory_iterator(dir, error)) {
+      if (entry.path().extension() == ".ch8") {
+        roms.push_back(entry.path().string());
+      }
+    }
+    if (error) {
+      std::cerr << "Can't list " << dir << std::endl;
+    }
+  }
+  std::sort(roms.begin(), roms.end());
+  return roms;
+}
+
+static void run_roms(const std::vector<std::string> &dirs,
+                     const std::string &filter, uint64_t frames,
+                     uint32_t inst_per_frame, Backend backend,
+                     double min_seconds, std::vector<Bench_result> &results) {
+  for (const std::string &rom : find_roms(dirs)) {
+    const std::string name =
+        "rom/" + std::filesystem::path(rom).filename().string();
+    if (name.find(filter) == std::string::npos) {
+      continue;
+    }
+    Rom_file file(rom.c_str());
+    if (file.get() == nullptr) {
+      std::cerr << "Skipping " << rom << ": " << file.why_not() << std::endl;
+      continue;
+    }
+    // A fresh machine per run; building it isn't timed
+    Bench_result result = {name, 0, 0, 0, 0, "instructions"};
+    do {
+      auto chip =
+          boot(*file.get(), PROFILE_DEFAULT, true, backend, inst_per_frame);
+      const auto start = std::chrono::steady_clock::now();
+      while (chip->get_frame_count() < frames &&
+             chip->get_state() == EmuState::RUNNING) {
+        chip->run_frame(chip->get_config().inst_per_frame);
+      }
+      result.seconds += std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+      result.items += chip->get_cycle_count();
+      result.frames += chip->get_frame_count();
+      result.iterations++;
+    } while (result.seconds < min_seconds);
+    results.push_back(result);
+  }
+}
+
+static std::string json_string(const std::string &text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+static void write_json(std::ostream &out,
+                       const std::vector<Bench_result> &results) {
+  char date[32];
+  const std::time_t now = std::time(nullptr);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+#ifdef NDEBUG
+  const char *build = "release";
+#else
+  const char *build = "debug";
+#endif
+#ifdef CHIP8_PROFILE
+  const bool profiled = true;
+#else
+  const bool profiled = false;
+#endif
+
+  out << "{\n  \"context\": {\n";
+  out << "    \"date\": " << json_string(date) << ",\n";
+  out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+  out << "    \"library_build_type\": \"" << build << "\",\n";
+  out << "    \"chip8_profile\": " << (profiled ? "true" : "false") << "\n";
+  out << "  },\n  \"benchmarks\": [";
+  for (size_t index = 0; index < results.size(); index++) {
+    const Bench_result &result = results[index];
+    const double per_iteration = result.seconds * 1e9 / result.iterations;
+    out << (index ? ",\n" : "\n") << "    {\n";
+    out << "      \"name\": " << json_string(result.name) << ",\n";
+    out << "      \"run_type\": \"iteration\",\n";
+    out << "      \"iterations\": " << result.iterations << ",\n";
+    out << "      \"real_time\": " << per_iteration << ",\n";
+    out << "      \"cpu_time\": " << per_iteration << ",\n";
+    out << "      \"time_unit\": \"ns\",\n";
+    out << "      \"items_per_second\": " << result.items / result.seconds
+        << ",\n";
+    out << "      \"unit\": \"" << result.unit << "\"";
+    if (strcmp(result.unit, "instructions") == 0) {
+      out << ",\n      \"mips\": " << result.items / result.seconds / 1e6;
+    }
+    if (result.frames > 0) {
+      out << ",\n      \"frames_per_second\": "
+          << result.frames / result.seconds;
+    }
+    out << "\n    }";
+  }
+  out << "\n  ]\n}\n";
+}
+
+int main(int argc, char **argv) {
+  const char *output_path = nullptr;
+  std::string filter;
+  double min_seconds = 0.5;
+  uint64_t frames = 600;
+  long inst_per_frame = 0;
+  Backend backend = BACKEND_CACHED;
+  std::vector<std::string> dirs;
+
+  for (int arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "--filter") == 0 && arg + 1 < argc) {
+      filter = argv[++arg];
+    } else if (strcmp(argv[arg], "--min-time") == 0 && arg + 1 < argc) {
+      min_seconds = std::strtod(argv[++arg], nullptr);
+    } else if (strcmp(argv[arg], "--frames") == 0 && arg + 1 < argc) {
+      frames = std::strtoull(argv[++arg], nullptr, 10);
+    } else if (strcmp(argv[arg], "--ipf") == 0 && arg + 1 < argc) {
+      inst_per_frame = std::strtol(argv[++arg], nullptr, 10);
+    } else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+      output_path = argv[++arg];
+    } else if (strcmp(argv[arg], "--backend") == 0 && arg + 1 < argc) {
+      arg++;
+      if (strcmp(argv[arg], "uncached") == 0) {
+        backend = BACKEND_UNCACHED;
+      } else if (strcmp(argv[arg], "recompiler") == 0) {
+        backend = BACKEND_RECOMPILER;
+      } else {
+        backend = BACKEND_CACHED;
+      }
+    } else if (argv[arg][0] == '-') {
+      std::cerr << "Usage --- chip8_bench [--filter <substring>] "
+                   "[--min-time <seconds>] [--frames <n>] "
+                   "[--ipf <inst-per-frame>] "
+                   "[--backend uncached|cached|recompiler] "
+                   "[-o <results.json>] [rom-dir...]"
+                << std::endl;
+      return 1;
+    } else {
+      dirs.push_back(argv[arg]);
+    }
+  }
+  if (dirs.empty()) {
+    dirs = {"chip8-roms/games", "chip8-roms/demos"};
+  }
+
+  std::vector<Bench_result> results;
+  run_kernels(filter, min_seconds, results);
+  run_framebuffer(filter, min_seconds, results);
+  run_roms(dirs, filter, frames,
+           inst_per_frame > 0 ? (uint32_t)inst_per_frame : 0, backend,
+           min_seconds, results);
+
+  // Human-readable summary on stderr, JSON on stdout or -o
+  for (const Bench_result &result : results) {
+    std::cerr << result.name << ": "
+              << result.seconds * 1e9 / result.iterations << " ns/iter, "
+              << result.items / result.seconds / 1e6 << " M " << result.unit
+              << "/s" << std::endl;
+  }
+  if (output_path != nullptr) {
+    std::ofstream out(output_path);
+    write_json(out, results);
+    if (!out) {
+      std::cerr << "Can't write " << output_path << std::endl;
+      return 1;
+    }
+  } else {
+    write_json(std::cout, results);
+  }
+  return 0;
+}
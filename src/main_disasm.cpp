@@ -0,0 +1,55 @@
+#include "disassembler.hpp"
+#include "quirks.hpp"
+#include "rom.hpp"
+#include <cstring>
+#include <iostream>
+
+// Disassembles a ROM by following its control flow from the entry point, so
+// sprites and tables come out as data instead of nonsense instructions.
+int main(int argc, char **argv) {
+  const char *rom_path = nullptr;
+  const char *quirks_name = "auto";
+  bool dot = false;
+
+  for (int arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "--quirks") == 0 && arg + 1 < argc) {
+      quirks_name = argv[++arg];
+    } else if (strcmp(argv[arg], "--dot") == 0) {
+      dot = true;
+    } else {
+      rom_path = argv[arg];
+    }
+  }
+
+  if (rom_path == nullptr) {
+    std::cerr << "Usage --- chip8_disasm "
+                 "[--quirks auto|default|chip8|chip8hires|schip|xochip] "
+                 "[--dot] <path-to-rom>"
+              << std::endl;
+    return 1;
+  }
+
+  Rom_file file(rom_path);
+  const Rom *rom = file.get();
+  if (rom == nullptr) {
+    std::cerr << "Can't load ROM " << rom_path << ": " << file.why_not()
+              << std::endl;
+    return 1;
+  }
+
+  // The platform decides what instructions there are, see main_headless.cpp
+  Profile profile = rom_profile(rom->hash);
+  if (strcmp(quirks_name, "auto") != 0 &&
+      !parse_profile(quirks_name, profile)) {
+    std::cerr << "Unknown quirks profile " << quirks_name << std::endl;
+    return 1;
+  }
+
+  const Rom_graph graph = analyze(*rom, profile_platform(profile));
+  if (dot) {
+    write_dot(std::cout, *rom, graph);
+  } else {
+    write_listing(std::cout, *rom, graph);
+  }
+  return 0;
+}
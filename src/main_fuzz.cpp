@@ -0,0 +1,587 @@
+#include "chip8.hpp"
+#include "disassembler.hpp"
+#include "framebuffer.hpp"
+#include "lanes.hpp"
+#include "quirks.hpp"
+#include "rom.hpp"
+#include "snapshot.hpp"
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Differential fuzzing: every input is a machine, a key script and a ROM,
+// run on the uncached interpreter (the reference) and on every faster way
+// of running it, comparing whole machine states after each frame. Built
+// with -DCHIP8_LIBFUZZER (clang, -fsanitize=fuzzer) this is a libFuzzer
+// target; otherwise it is a standalone tool that generates random inputs,
+// replays saved ones, or checks known test ROMs against recorded results.
+
+// An input starts with this header, then one little-endian keypad word
+// per frame, then the ROM.
+typedef struct {
+  uint8_t profile;        // Profile, modulo the number of profiles
+  uint8_t flags;          // FUZZ_*
+  uint8_t inst_per_frame; // 1 + this modulo FUZZ_MAX_IPF
+  uint8_t frames;         // 1 + this modulo FUZZ_MAX_FRAMES
+  uint32_t seed;
+} Fuzz_header;
+
+#define FUZZ_VIP 0x01   // TIMING_VIP instead of instructions per frame
+#define FUZZ_PROFILES 5 // PROFILE_DEFAULT to PROFILE_XOCHIP
+#define FUZZ_MAX_IPF 64
+#define FUZZ_MAX_FRAMES 64
+#define FUZZ_MAX_ROM 4096 // longer ROMs only add code nothing reaches
+
+static_assert(sizeof(Fuzz_header) == 8, "Fuzz_header layout changed");
+
+// The ways of running a machine checked against the reference.
+enum Fuzz_engine {
+  ENGINE_CACHED,
+  ENGINE_PREDECODED, // cached, filled in by predecode() before starting
+  ENGINE_RECOMPILER,
+  ENGINE_RECOMPILER_PREDECODED,
+  ENGINE_DEBUGGER, // cached, stopped at a breakpoint and resumed every visit
+  ENGINE_STEPPER,  // cached, single stepped through every instruction
+};
+
+static const struct {
+  const char *name;
+  Backend backend;
+  Fuzz_engine engine;
+} fuzz_engines[] = {
+    {"cached", BACKEND_CACHED, ENGINE_CACHED},
+    {"predecoded", BACKEND_CACHED, ENGINE_PREDECODED},
+    {"recompiler", BACKEND_RECOMPILER, ENGINE_RECOMPILER},
+    {"recompiler+predecode", BACKEND_RECOMPILER,
+     ENGINE_RECOMPILER_PREDECODED},
+    {"debugger", BACKEND_CACHED, ENGINE_DEBUGGER},
+    {"stepper", BACKEND_CACHED, ENGINE_STEPPER},
+};
+
+// A decoded input.
+typedef struct {
+  Profile profile;
+  Timing timing;
+  uint32_t inst_per_frame;
+  uint32_t frames;
+  uint32_t seed;
+  std::vector<uint16_t> keys; // per frame
+  Rom rom;
+} Fuzz_case;
+
+static bool parse_case(const uint8_t *data, size_t size, Fuzz_case &fuzz) {
+  Fuzz_header header;
+  if (size < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  fuzz.profile = (Profile)(header.profile % FUZZ_PROFILES);
+  fuzz.timing = header.flags & FUZZ_VIP ? TIMING_VIP : TIMING_INSTRUCTIONS;
+  fuzz.inst_per_frame = 1 + header.inst_per_frame % FUZZ_MAX_IPF;
+  fuzz.frames = 1 + header.frames % FUZZ_MAX_FRAMES;
+  fuzz.seed = header.seed;
+
+  size_t pos = sizeof(header);
+  if (size - pos < fuzz.frames * 2 + 2) {
+    return false;
+  }
+  fuzz.keys.resize(fuzz.frames);
+  for (uint32_t frame = 0; frame < fuzz.frames; frame++) {
+    fuzz.keys[frame] = (uint16_t)(data[pos] | data[pos + 1] << 8);
+    pos += 2;
+  }
+  const uint32_t rom_size = (uint32_t)std::min<size_t>(size - pos,
+                                                       FUZZ_MAX_ROM);
+  fuzz.rom = {data + pos, rom_size, rom_hash(data + pos, rom_size)};
+  return true;
+}
+
+static std::unique_ptr<Chip8> make_machine(const Fuzz_case &fuzz,
+                                           Backend backend) {
+  auto chip = std::make_unique<Chip8>(fuzz.rom);
+  config_t config = chip->get_config();
+  config.backend = backend;
+  config.timing = fuzz.timing;
+  config.quirks = profile_quirks(fuzz.profile);
+  config.platform = profile_platform(fuzz.profile);
+  chip->set_config(config);
+  chip->seed(fuzz.seed);
+  return chip;
+}
+
+// One frame with keys down. A debugged machine stops partway through at
+// its breakpoint or after a step; it is resumed, or stepped again, until
+// the frame is done.
+static void run_frame(Chip8 &chip, const Fuzz_case &fuzz, uint16_t keys) {
+  chip.set_keys(keys);
+  const uint64_t frame = chip.get_frame_count();
+  Debugger *debugger = chip.get_debugger();
+  do {
+    if (debugger != nullptr && debugger->get_stop() == DEBUG_STEP) {
+      debugger->step();
+    } else if (debugger != nullptr && debugger->stopped()) {
+      debugger->resume();
+    }
+    chip.run_frame(fuzz.inst_per_frame);
+  } while (chip.get_frame_count() == frame &&
+           chip.get_state() == EmuState::RUNNING);
+}
+
+// The first thing two states disagree on, or "" if they are the same.
+static std::string difference(const Snapshot &expected,
+                              const Snapshot &actual) {
+  char text[96];
+  auto field = [&](const char *name, uint64_t a, uint64_t b) {
+    snprintf(text, sizeof(text), "%s is %" PRIX64 ", expected %" PRIX64, name,
+             b, a);
+    return std::string(text);
+  };
+  if (expected.platform != actual.platform ||
+      expected.mem_size != actual.mem_size) {
+    return field("mem_size", expected.mem_size, actual.mem_size) +
+           " (or the platform differs)";
+  }
+  if (expected.pc != actual.pc) {
+    return field("pc", expected.pc, actual.pc);
+  }
+  if (expected.i != actual.i) {
+    return field("I", expected.i, actual.i);
+  }
+  for (uint32_t reg = 0; reg < 16; reg++) {
+    if (expected.gpr[reg] != actual.gpr[reg]) {
+      const char name[] = {'V', "0123456789ABCDEF"[reg], '\0'};
+      return field(name, expected.gpr[reg], actual.gpr[reg]);
+    }
+  }
+  if (expected.sp != actual.sp ||
+      memcmp(expected.stack, actual.stack, sizeof(expected.stack)) != 0) {
+    return field("sp", expected.sp, actual.sp) + " (or the stack differs)";
+  }
+  for (uint32_t addr = 0; addr < expected.mem_size; addr++) {
+    if (expected.mem[addr] != actual.mem[addr]) {
+      char name[16];
+      snprintf(name, sizeof(name), "mem[%04X]", addr);
+      return field(name, expected.mem[addr], actual.mem[addr]);
+    }
+  }
+  if (memcmp(expected.display, actual.display, sizeof(expected.display)) !=
+          0 ||
+      expected.resolution != actual.resolution ||
+      expected.planes != actual.planes) {
+    return "the display";
+  }
+  if (expected.delay != actual.delay || expected.sound != actual.sound) {
+    return field("delay/sound", expected.delay << 8 | expected.sound,
+                 actual.delay << 8 | actual.sound);
+  }
+  if (expected.state != actual.state) {
+    return field("state", expected.state, actual.state);
+  }
+  if (expected.cycle_count != actual.cycle_count) {
+    return field("cycle_count", expected.cycle_count, actual.cycle_count);
+  }
+  if (expected.machine_cycles != actual.machine_cycles ||
+      expected.cycle_debt != actual.cycle_debt) {
+    return field("machine_cycles", expected.machine_cycles,
+                 actual.machine_cycles);
+  }
+  if (memcmp(&expected, &actual, snapshot_size(expected)) != 0) {
+    return "the rest of the state (rng, keypad, rpl, audio)";
+  }
+  return "";
+}
+
+// Runs an input on the reference and every engine, plus the lanes core
+// where it applies. Returns what diverged first, or "" if nothing did or
+// the input is too short to be a case.
+static std::string fuzz_one(const uint8_t *data, size_t size) {
+  Fuzz_case fuzz;
+  if (!parse_case(data, size, fuzz)) {
+    return "";
+  }
+
+  // Somewhere in the ROM, even or odd, reached or not
+  Debugger debugger;
+  debugger.set_breakpoint(
+      (uint16_t)(ROM_ENTRY_POINT + fuzz.seed % fuzz.rom.size), true);
+  Debugger stepper;
+  stepper.step();
+  auto reference = make_machine(fuzz, BACKEND_UNCACHED);
+  std::vector<std::unique_ptr<Chip8>> machines;
+  const Rom_graph graph =
+      analyze(fuzz.rom, profile_platform(fuzz.profile));
+  for (const auto &engine : fuzz_engines) {
+    auto chip = make_machine(fuzz, engine.backend);
+    if (engine.engine == ENGINE_PREDECODED ||
+        engine.engine == ENGINE_RECOMPILER_PREDECODED) {
+      chip->predecode(graph);
+    } else if (engine.engine == ENGINE_DEBUGGER) {
+      chip->set_debugger(&debugger);
+    } else if (engine.engine == ENGINE_STEPPER) {
+      chip->set_debugger(&stepper);
+    }
+    machines.push_back(std::move(chip));
+  }
+
+  // Lanes: one lane as the input says, a second on other keys and seed
+  // against a reference of its own, so the lanes part ways
+  const bool lanes_apply =
+      Chip8_lanes::supports(reference->get_config()) &&
+      fuzz.rom.size <= LANE_MEM_SIZE - ROM_ENTRY_POINT;
+  std::unique_ptr<Chip8> other;
+  std::unique_ptr<Chip8_lanes> lanes;
+  auto expected = std::make_unique<Snapshot>();
+  auto actual = std::make_unique<Snapshot>();
+  if (lanes_apply) {
+    other = make_machine(fuzz, BACKEND_UNCACHED);
+    other->seed(~fuzz.seed);
+    lanes = std::make_unique<Chip8_lanes>(2, reference->get_config());
+    reference->save_state(*expected);
+    lanes->load_state(0, *expected);
+    other->save_state(*expected);
+    lanes->load_state(1, *expected);
+  }
+
+  char where[64];
+  for (uint32_t frame = 0; frame < fuzz.frames; frame++) {
+    const uint16_t keys = fuzz.keys[frame];
+    snprintf(where, sizeof(where), " after frame %u: ", frame + 1);
+    run_frame(*reference, fuzz, keys);
+    reference->save_state(*expected);
+    for (size_t n = 0; n < machines.size(); n++) {
+      run_frame(*machines[n], fuzz, keys);
+      machines[n]->save_state(*actual);
+      const std::string diff = difference(*expected, *actual);
+      if (!diff.empty()) {
+        return fuzz_engines[n].name + std::string(where) + diff;
+      }
+    }
+    if (lanes_apply) {
+      lanes->set_keys(0, keys);
+      lanes->set_keys(1, (uint16_t)~keys);
+      lanes->run_frame(fuzz.inst_per_frame);
+      lanes->save_state(0, *actual);
+      std::string diff = difference(*expected, *actual);
+      if (diff.empty()) {
+        run_frame(*other, fuzz, (uint16_t)~keys);
+        other->save_state(*expected);
+        lanes->save_state(1, *actual);
+        diff = difference(*expected, *actual);
+      }
+      if (!diff.empty()) {
+        return "lanes" + std::string(where) + diff;
+      }
+    }
+    if (reference->get_state() != EmuState::RUNNING) {
+      break;
+    }
+  }
+  return "";
+}
+
+#if defined(CHIP8_LIBFUZZER)
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  const std::string diff = fuzz_one(data, size);
+  if (!diff.empty()) {
+    std::cerr << "Divergence: " << diff << std::endl;
+    abort(); // libFuzzer saves the input
+  }
+  return 0;
+}
+
+#else
+
+// A random input that is mostly instructions, with jumps, calls and I
+// pointing back into the ROM so the programs loop, draw and modify
+// themselves rather than run off into zeroed memory. first is the ROM's
+// first instruction, to check the input parses back the way it was built.
+static std::vector<uint8_t> random_input(std::mt19937 &rng, uint16_t &first) {
+  auto below = [&](uint32_t n) { return (uint32_t)(rng() % n); };
+  std::vector<uint8_t> input(sizeof(Fuzz_header));
+  for (uint8_t &byte : input) {
+    byte = (uint8_t)rng();
+  }
+  const uint32_t frames = 1 + input[3] % FUZZ_MAX_FRAMES;
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    // Mostly nothing pressed, sometimes one key, rarely anything
+    const uint32_t roll = below(8);
+    const uint16_t keys = roll < 5   ? 0
+                          : roll < 7 ? (uint16_t)(1 << below(16))
+                                     : (uint16_t)rng();
+    input.push_back((uint8_t)keys);
+    input.push_back((uint8_t)(keys >> 8));
+  }
+
+  const uint32_t count = 8 + below(248);
+  const uint32_t end = ROM_ENTRY_POINT + count * 2;
+  for (uint32_t n = 0; n < count; n++) {
+    uint16_t inst = (uint16_t)rng();
+    const uint16_t target = (uint16_t)(ROM_ENTRY_POINT + below(count) * 2 +
+                                       (below(16) == 0 ? 1 : 0));
+    switch (below(16)) {
+    case 0: {
+      static const uint16_t system[] = {0x00E0, 0x00EE, 0x00C3, 0x00D2,
+                                        0x00FB, 0x00FC, 0x00FD, 0x00FE,
+                                        0x00FF, 0x0230, 0x1260, 0xF000,
+                                        0xF101, 0xF202, 0x5012, 0x5013};
+      inst = system[below(16)];
+      break;
+    }
+    case 1:
+    case 2:
+    case 0xB:
+      inst = (uint16_t)((inst & 0xF000) | (target & 0x0FFF));
+      if (below(2) == 0) {
+        inst = (uint16_t)((below(2) ? 0x1000 : 0x2000) | (target & 0x0FFF));
+      }
+      break;
+    case 0xA:
+      // Into the ROM, the font, or anywhere
+      inst = (uint16_t)(0xA000 | (below(4) == 0   ? 0x050 + below(80)
+                                  : below(4) != 0 ? ROM_ENTRY_POINT +
+                                                        below(end -
+                                                              ROM_ENTRY_POINT)
+                                                  : below(0x1000)));
+      break;
+    case 0xF: {
+      static const uint8_t low[] = {0x07, 0x0A, 0x15, 0x18, 0x1E, 0x29,
+                                    0x30, 0x33, 0x3A, 0x55, 0x65, 0x75,
+                                    0x85};
+      inst = (uint16_t)(0xF000 | (inst & 0x0F00) | low[below(sizeof(low))]);
+      break;
+    }
+    default:
+      break;
+    }
+    if (n == 0) {
+      first = inst;
+    }
+    input.push_back((uint8_t)(inst >> 8));
+    input.push_back((uint8_t)inst);
+  }
+  return input;
+}
+
+static bool read_file(const char *path, std::vector<uint8_t> &data) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  data.assign(std::istreambuf_iterator<char>(file),
+              std::istreambuf_iterator<char>());
+  return true;
+}
+
+// Saves an input that diverged under a name from its content, for replay.
+static std::string save_input(const std::vector<uint8_t> &input) {
+  char path[64];
+  snprintf(path, sizeof(path), "fuzz-%016" PRIx64 ".bin",
+           rom_hash(input.data(), (uint32_t)input.size()));
+  std::ofstream file(path, std::ios::binary);
+  file.write((const char *)input.data(), (std::streamsize)input.size());
+  return path;
+}
+
+// Known test ROMs and what they show after running for a while on every
+// engine. The test programs print their results through FX33, and the
+// pictures were checked by eye: SQRT Test shows 012, Division Test 005
+// twice, Delay Timer Test counts V3 up to 034 with 2 held, Random Number
+// Test shows 135, the first CXNN byte for its seed. The games cover the
+// arithmetic, shifts and FX1E with whatever they show at that point.
+typedef struct {
+  const char *path; // under the ROM directory
+  Profile profile;
+  uint32_t frames;
+  uint16_t keys; // held down throughout
+  uint32_t seed;
+  uint64_t display_hash;
+} Golden_rom;
+
+static const Golden_rom golden_roms[] = {
+    {"programs/IBM Logo.ch8", PROFILE_DEFAULT, 60, 0, 1,
+     0xc094f65422bd4e58ULL},
+    {"programs/SQRT Test [Sergey Naydenov, 2010].ch8", PROFILE_DEFAULT, 120,
+     0, 1, 0x8935875a77458682ULL},
+    {"programs/Division Test [Sergey Naydenov, 2010].ch8", PROFILE_DEFAULT,
+     120, 0, 1, 0x36876c75267f1cc5ULL},
+    {"programs/Delay Timer Test [Matthew Mikolay, 2010].ch8",
+     PROFILE_DEFAULT, 61, 0x0004, 1, 0x52291c7d57758cbeULL},
+    {"programs/Random Number Test [Matthew Mikolay, 2010].ch8",
+     PROFILE_DEFAULT, 120, 0, 0x12345678, 0xfae75b5b973c97daULL},
+    {"hires/Hires Test [Tom Swan, 1979].ch8", PROFILE_CHIP8_HIRES, 120, 0, 1,
+     0x5db625bc310dd265ULL},
+    {"games/Brix [Andreas Gustafsson, 1990].ch8", PROFILE_DEFAULT, 300, 0, 1,
+     0xb2c74aa3396f817eULL},
+    {"games/Pong [Paul Vervalin, 1990].ch8", PROFILE_DEFAULT, 300, 0, 1,
+     0xa08265295fc2f696ULL},
+    {"games/Tetris [Fran Dachille, 1991].ch8", PROFILE_DEFAULT, 300, 0, 1,
+     0xa0c70c85f3e216b6ULL},
+};
+
+static uint64_t golden_run(const Golden_rom &golden, const Rom &rom,
+                           Backend backend, bool predecoded) {
+  Fuzz_case fuzz = {golden.profile, TIMING_INSTRUCTIONS, 12, golden.frames,
+                    golden.seed, {}, rom};
+  auto chip = make_machine(fuzz, backend);
+  if (predecoded) {
+    chip->predecode(analyze(rom, profile_platform(golden.profile)));
+  }
+  for (uint32_t frame = 0; frame < golden.frames; frame++) {
+    run_frame(*chip, fuzz, golden.keys);
+  }
+  return chip->display_hash();
+}
+
+// The same on one lane of the lanes core, for ROMs it can run.
+static uint64_t golden_lanes(const Golden_rom &golden, const Rom &rom) {
+  Fuzz_case fuzz = {golden.profile, TIMING_INSTRUCTIONS, 12, golden.frames,
+                    golden.seed, {}, rom};
+  auto chip = make_machine(fuzz, BACKEND_CACHED);
+  auto state = std::make_unique<Snapshot>();
+  chip->save_state(*state);
+  auto lanes = std::make_unique<Chip8_lanes>(1, chip->get_config());
+  lanes->load_state(0, *state);
+  lanes->set_keys(0, golden.keys);
+  for (uint32_t frame = 0; frame < golden.frames; frame++) {
+    lanes->run_frame(fuzz.inst_per_frame);
+  }
+  return lanes->display_hash(0);
+}
+
+// Runs every golden ROM on every engine. Returns how many didn't show what
+// they should. With print, only shows what the reference shows instead,
+// for adding ROMs to the table.
+static int run_golden(const std::string &dir, bool print) {
+  int failed = 0;
+  for (const Golden_rom &golden : golden_roms) {
+    const std::string path = dir + "/" + golden.path;
+    Rom_file file(path.c_str());
+    if (file.get() == nullptr) {
+      std::cerr << path << ": " << file.why_not() << std::endl;
+      failed++;
+      continue;
+    }
+    const Rom &rom = *file.get();
+    if (print) {
+      printf("0x%016" PRIx64 " %s\n",
+             golden_run(golden, rom, BACKEND_UNCACHED, false), golden.path);
+      continue;
+    }
+
+    std::vector<std::string> wrong;
+    if (golden_run(golden, rom, BACKEND_UNCACHED, false) !=
+        golden.display_hash) {
+      wrong.push_back("uncached");
+    }
+    for (const auto &engine : fuzz_engines) {
+      const bool predecoded = engine.engine == ENGINE_PREDECODED ||
+                              engine.engine == ENGINE_RECOMPILER_PREDECODED;
+      if (engine.engine != ENGINE_DEBUGGER &&
+          engine.engine != ENGINE_STEPPER &&
+          golden_run(golden, rom, engine.backend, predecoded) !=
+              golden.display_hash) {
+        wrong.push_back(engine.name);
+      }
+    }
+    if (golden.profile == PROFILE_DEFAULT &&
+        golden_lanes(golden, rom) != golden.display_hash) {
+      wrong.push_back("lanes");
+    }
+
+    if (wrong.empty()) {
+      std::cout << "ok   " << golden.path << std::endl;
+      continue;
+    }
+    std::string engines;
+    for (const std::string &name : wrong) {
+      engines += (engines.empty() ? "" : ", ") + name;
+    }
+    std::cout << "FAIL " << golden.path << " (" << engines << ")"
+              << std::endl;
+    failed++;
+  }
+  return failed;
+}
+
+int main(int argc, char **argv) {
+  uint64_t runs = 10000;
+  uint32_t seed = 1;
+  const char *golden_dir = nullptr;
+  bool print = false;
+  std::vector<const char *> inputs;
+  for (int arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "--runs") == 0 && arg + 1 < argc) {
+      runs = std::strtoull(argv[++arg], nullptr, 10);
+    } else if (strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc) {
+      seed = (uint32_t)std::strtoul(argv[++arg], nullptr, 0);
+    } else if (strcmp(argv[arg], "--golden") == 0 && arg + 1 < argc) {
+      golden_dir = argv[++arg];
+    } else if (strcmp(argv[arg], "--print") == 0) {
+      print = true;
+    } else if (argv[arg][0] == '-') {
+      std::cerr << "Usage --- chip8_fuzz [--runs <n>] [--seed <n>] | "
+                   "chip8_fuzz <input>... | "
+                   "chip8_fuzz --golden <rom-dir> [--print]"
+                << std::endl;
+      return 2;
+    } else {
+      inputs.push_back(argv[arg]);
+    }
+  }
+
+  if (golden_dir != nullptr) {
+    return run_golden(golden_dir, print) == 0 ? 0 : 1;
+  }
+
+  // Replaying saved inputs, or ones libFuzzer found
+  if (!inputs.empty()) {
+    int status = 0;
+    for (const char *path : inputs) {
+      std::vector<uint8_t> data;
+      if (!read_file(path, data)) {
+        std::cerr << "Can't read " << path << std::endl;
+        return 2;
+      }
+      const std::string diff = fuzz_one(data.data(), data.size());
+      std::cout << path << ": " << (diff.empty() ? "ok" : diff) << std::endl;
+      status = diff.empty() ? status : 1;
+    }
+    return status;
+  }
+
+  std::mt19937 rng(seed);
+  for (uint64_t run = 0; run < runs; run++) {
+    uint16_t first = 0;
+    const std::vector<uint8_t> input = random_input(rng, first);
+    // Targets are computed from the entry point, so the ROM has to start
+    // where the generator put it
+    Fuzz_case fuzz;
+    if (!parse_case(input.data(), input.size(), fuzz) ||
+        (fuzz.rom.data[0] << 8 | fuzz.rom.data[1]) != first) {
+      std::cerr << "run " << run << ": the input doesn't parse back into "
+                << "the ROM generated" << std::endl;
+      return 2;
+    }
+    const std::string diff = fuzz_one(input.data(), input.size());
+    if (!diff.empty()) {
+      std::cout << "run " << run << ": " << diff << " (saved to "
+                << save_input(input) << ")" << std::endl;
+      return 1;
+    }
+  }
+  std::cout << runs << " runs, no divergence" << std::endl;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,322 @@
+#include "chip8.hpp"
+#include "debug_server.hpp"
+#include "movie.hpp"
+#include "quirks.hpp"
+#include "rom.hpp"
+#include "video.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+// Runs a ROM with no window for a fixed number of 60Hz frames and reports
+// what it did. Frames run back to back at full host speed; delay/sound still
+// tick once per emulated frame.
+int main(int argc, char **argv) {
+  char *rom_path = nullptr;
+  uint64_t frames = 600;
+  bool frames_given = false;
+  long inst_per_frame = 0;
+  Timing timing = TIMING_INSTRUCTIONS;
+  const char *quirks_name = "auto";
+  Backend backend = BACKEND_CACHED;
+  bool frame_log = false;
+  bool predecode = false;
+  const char *load_path = nullptr;
+  const char *save_path = nullptr;
+  const char *movie_path = nullptr;
+  const char *profile_path = nullptr;
+  const char *debug_path = nullptr;
+  const char *trace_path = nullptr;
+  const char *video_path = nullptr;
+  long video_scale = 4;
+  bool video_drop = false;
+  bool seeded = false;
+  uint32_t seed = 0;
+  int positional = 0;
+
+  for (int arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "--ipf") == 0 && arg + 1 < argc) {
+      inst_per_frame = std::strtol(argv[++arg], nullptr, 10);
+    } else if (strcmp(argv[arg], "--load-state") == 0 && arg + 1 < argc) {
+      load_path = argv[++arg];
+    } else if (strcmp(argv[arg], "--save-state") == 0 && arg + 1 < argc) {
+      save_path = argv[++arg];
+    } else if (strcmp(argv[arg], "--play") == 0 && arg + 1 < argc) {
+      movie_path = argv[++arg];
+    } else if (strcmp(argv[arg], "--quirks") == 0 && arg + 1 < argc) {
+      quirks_name = argv[++arg];
+    } else if (strcmp(argv[arg], "--timing") == 0 && arg + 1 < argc) {
+      arg++;
+      if (strcmp(argv[arg], "vip") == 0) {
+        timing = TIMING_VIP;
+      } else {
+        timing = TIMING_INSTRUCTIONS;
+      }
+    } else if (strcmp(argv[arg], "--profile") == 0 && arg + 1 < argc) {
+      profile_path = argv[++arg];
+    } else if (strcmp(argv[arg], "--trace") == 0 && arg + 1 < argc) {
+      trace_path = argv[++arg];
+    } else if (strcmp(argv[arg], "--video") == 0 && arg + 1 < argc) {
+      video_path = argv[++arg];
+    } else if (strcmp(argv[arg], "--video-scale") == 0 && arg + 1 < argc) {
+      video_scale = std::strtol(argv[++arg], nullptr, 10);
+    } else if (strcmp(argv[arg], "--video-drop") == 0) {
+      video_drop = true;
+    } else if (strcmp(argv[arg], "--debug") == 0 && arg + 1 < argc) {
+      debug_path = argv[++arg];
+    } else if (strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc) {
+      seed = (uint32_t)std::strtoul(argv[++arg], nullptr, 0);
+      seeded = true;
+    } else if (strcmp(argv[arg], "--frame-log") == 0) {
+      frame_log = true;
+    } else if (strcmp(argv[arg], "--predecode") == 0) {
+      predecode = true;
+    } else if (strcmp(argv[arg], "--backend") == 0 && arg + 1 < argc) {
+      arg++;
+      if (strcmp(argv[arg], "uncached") == 0) {
+        backend = BACKEND_UNCACHED;
+      } else if (strcmp(argv[arg], "recompiler") == 0) {
+        backend = BACKEND_RECOMPILER;
+      } else {
+        backend = BACKEND_CACHED;
+      }
+    } else if (positional++ == 0) {
+      rom_path = argv[arg];
+    } else {
+      frames = std::strtoull(argv[arg], nullptr, 10);
+      frames_given = true;
+    }
+  }
+
+  if (rom_path == nullptr) {
+    std::cerr << "Usage --- chip8_headless [--ipf <inst-per-frame>] "
+                 "[--backend uncached|cached|recompiler] "
+                 "[--timing instructions|vip] "
+                 "[--quirks auto|default|chip8|chip8hires|schip|xochip] "
+                 "[--frame-log] [--predecode] [--profile <prefix>] "
+                 "[--trace <file>] [--debug -|<port>|<socket>] "
+                 "[--video <file.gif|file.y4m|->] [--video-scale <n>] "
+                 "[--video-drop] "
+                 "[--seed <n>] [--play <movie>] [--load-state <file>] "
+                 "[--save-state <file>] <path-to-rom> [frames]"
+              << std::endl;
+    return 1;
+  }
+
+  Rom_file rom(rom_path);
+  if (rom.get() == nullptr) {
+    std::cerr << "Can't load ROM " << rom_path << ": " << rom.why_not()
+              << std::endl;
+    return 1;
+  }
+  // On the heap, see main.cpp
+  auto machine = std::make_unique<Chip8>(*rom.get());
+  Chip8 &chip = *machine;
+  config_t config = chip.get_config();
+  config.backend = backend;
+  config.timing = timing;
+
+  // Known ROMs get the machine they were written for unless told otherwise
+  Profile profile = rom_profile(chip.get_rom_hash());
+  if (strcmp(quirks_name, "auto") != 0 &&
+      !parse_profile(quirks_name, profile)) {
+    std::cerr << "Unknown quirks profile " << quirks_name << std::endl;
+    return 1;
+  }
+  config.quirks = profile_quirks(profile);
+  config.platform = profile_platform(profile);
+  if (inst_per_frame > 0) {
+    config.inst_per_frame = (uint32_t)inst_per_frame;
+  }
+  if (seeded) {
+    chip.seed(seed);
+  }
+
+  // A movie brings its own seed and speed, and runs to its end by default
+  Movie movie;
+  if (movie_path != nullptr) {
+    if (!movie.load(movie_path)) {
+      std::cerr << "Can't load movie from " << movie_path << std::endl;
+      return 1;
+    }
+    const Movie_header &header = movie.get_header();
+    if (header.rom_hash != chip.get_rom_hash()) {
+      std::cerr << "Movie was recorded with a different ROM" << std::endl;
+      return 1;
+    }
+    chip.seed(header.seed);
+    config.inst_per_frame = header.inst_per_frame;
+    config.timing = (Timing)header.timing;
+    config.cycles_per_frame = header.cycles_per_frame;
+    config.quirks = header.quirks;
+    config.platform = (Platform)header.platform;
+    if (!frames_given) {
+      frames = header.frames;
+    }
+  }
+  chip.set_config(config);
+
+  if (load_path != nullptr) {
+    Snapshot_file snapshot(load_path);
+    if (snapshot.get() == nullptr || !chip.load_state(*snapshot.get())) {
+      std::cerr << "Can't load state from " << load_path << std::endl;
+      return 1;
+    }
+  }
+
+  // Decode everything analysis can reach now rather than on first visit
+  if (predecode) {
+    chip.predecode(analyze(*rom.get(), config.platform));
+  }
+
+  Profiler profiler;
+  if (profile_path != nullptr) {
+#ifndef CHIP8_PROFILE
+    std::cerr << "Built without CHIP8_PROFILE, the profile will be empty"
+              << std::endl;
+#endif
+    chip.set_profiler(&profiler);
+  }
+
+  // Every instruction from here on, written out as the run goes
+  std::unique_ptr<Tracer> tracer;
+  if (trace_path != nullptr) {
+    tracer = std::make_unique<Tracer>(trace_path, chip);
+    if (!tracer->ok()) {
+      std::cerr << "Can't write a trace to " << trace_path << std::endl;
+      return 1;
+    }
+    chip.set_tracer(tracer.get());
+  }
+
+  // What the display shows every frame, encoded on a thread of its own.
+  // Frames here run faster than any encoder, so unless told to drop
+  // pictures the run waits for it when its queue is full. A Y4M stream on
+  // stdout moves the report to stderr.
+  std::unique_ptr<Video_writer> video;
+  Video_format video_type;
+  if (video_path != nullptr) {
+    if (!video_format(video_path, video_type)) {
+      std::cerr << "Can't tell the video format of " << video_path
+                << ", use .gif, .y4m or -" << std::endl;
+      return 1;
+    }
+    if (video_scale < 1 || video_scale > VIDEO_MAX_SCALE) {
+      std::cerr << "--video-scale goes from 1 to " << VIDEO_MAX_SCALE
+                << std::endl;
+      return 1;
+    }
+    if (debug_path != nullptr && strcmp(video_path, "-") == 0 &&
+        strcmp(debug_path, "-") == 0) {
+      std::cerr << "The video and the debugger can't both use stdout"
+                << std::endl;
+      return 1;
+    }
+    video = std::make_unique<Video_writer>(video_path, video_type,
+                                           (uint32_t)video_scale, config,
+                                           video_drop);
+    if (!video->ok()) {
+      std::cerr << "Can't write video to " << video_path << std::endl;
+      return 1;
+    }
+  }
+  std::ostream &report =
+      video_path != nullptr && strcmp(video_path, "-") == 0 ? std::cerr
+                                                            : std::cout;
+
+  // Starts stopped at the first instruction, and stays attached after the
+  // machine halts until the client lets go
+  Debugger debugger;
+  Debug_server debug_server(chip, debugger);
+  bool debugging = false;
+  if (debug_path != nullptr) {
+    if (!debug_server.open(debug_path)) {
+      std::cerr << "Can't serve the debugger on " << debug_path << std::endl;
+      return 1;
+    }
+    chip.set_debugger(&debugger);
+    debugging = true;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t display_version = chip.get_display_version();
+  while (chip.get_frame_count() < frames) {
+    if (debugging) {
+      debugging = debug_server.serve();
+    }
+    if (chip.get_state() != EmuState::RUNNING) {
+      break;
+    }
+    if (movie_path != nullptr) {
+      movie.play(chip);
+    }
+    const uint64_t frame = chip.get_frame_count();
+    chip.run_frame(config.inst_per_frame);
+    // A frame the debugger held isn't over yet
+    if (video != nullptr && chip.get_frame_count() != frame) {
+      video->frame(chip);
+    }
+
+    // Only frames that changed the display get hashed and logged
+    if (frame_log && chip.get_display_version() != display_version) {
+      display_version = chip.get_display_version();
+      report << "frame " << chip.get_frame_count() << " " << std::hex
+             << chip.display_hash() << std::dec << std::endl;
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  Snapshot snapshot;
+  chip.save_state(snapshot);
+  if (save_path != nullptr) {
+    if (!save_snapshot_file(save_path, snapshot)) {
+      std::cerr << "Can't save state to " << save_path << std::endl;
+      return 1;
+    }
+  }
+
+  if (tracer != nullptr && !tracer->finish()) {
+    std::cerr << "Can't write a trace to " << trace_path << std::endl;
+    return 1;
+  }
+
+  if (video != nullptr) {
+    if (!video->finish()) {
+      std::cerr << "Can't write video to " << video_path << std::endl;
+      return 1;
+    }
+    if (video->get_dropped() > 0) {
+      std::cerr << video->get_dropped()
+                << " frames showed an earlier picture, the video writer fell "
+                   "behind"
+                << std::endl;
+    }
+  }
+
+  if (profile_path != nullptr && !save_profile(profile_path, profiler)) {
+    std::cerr << "Can't save profile to " << profile_path << std::endl;
+    return 1;
+  }
+
+  report << "frames: " << chip.get_frame_count() << std::endl;
+  report << "cycles: " << chip.get_cycle_count() << std::endl;
+  report << "seconds: " << elapsed.count() << std::endl;
+  report << "mips: " << (chip.get_cycle_count() / elapsed.count()) / 1e6
+         << std::endl;
+  if (config.timing == TIMING_VIP) {
+    // Emulated time against host time: how much faster than a VIP this is
+    report << "machine_cycles: " << chip.get_machine_cycles() << std::endl;
+    report << "vip_speed: "
+           << (chip.get_frame_count() / 60.0) / elapsed.count() << "x"
+           << std::endl;
+  }
+  report << "display_hash: " << std::hex << chip.display_hash() << std::dec
+         << std::endl;
+  report << "state_hash: " << std::hex << snapshot_hash(snapshot)
+         << std::dec << std::endl;
+  return chip.get_state() == EmuState::RUNNING ? 0 : 2;
+}
@@ -0,0 +1,177 @@
+#include "disassembler.hpp"
+#include "trace.hpp"
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+
+#define TRACE_READ_RECORDS 4096 // records per read
+#define TRACE_CONTEXT 8         // matching records shown before a difference
+
+// Reads a trace file front to back a block at a time, so traces of any
+// length decode in constant memory.
+class Trace_reader {
+private:
+  std::FILE *file;
+  Trace_record buffer[TRACE_READ_RECORDS];
+  size_t count;
+  size_t pos;
+
+public:
+  Trace_header header;
+
+  Trace_reader(const char *path)
+      : file(std::fopen(path, "rb")), count(0), pos(0), header() {
+    if (this->file != nullptr &&
+        (std::fread(&this->header, sizeof(this->header), 1, this->file) != 1 ||
+         this->header.magic != TRACE_MAGIC ||
+         this->header.version != TRACE_VERSION)) {
+      std::fclose(this->file);
+      this->file = nullptr;
+    }
+  }
+  bool ok() const { return this->file != nullptr; }
+  bool next(Trace_record &record) {
+    if (this->pos == this->count) {
+      this->count = this->file != nullptr
+                        ? std::fread(this->buffer, sizeof(Trace_record),
+                                     TRACE_READ_RECORDS, this->file)
+                        : 0;
+      this->pos = 0;
+      if (this->count == 0) {
+        return false;
+      }
+    }
+    record = this->buffer[this->pos++];
+    return true;
+  }
+  ~Trace_reader() {
+    if (this->file != nullptr) {
+      std::fclose(this->file);
+    }
+  }
+};
+
+static uint64_t frame_number(const Trace_record &record) {
+  return record.pc | (uint64_t)record.inst << 16 |
+         (uint64_t)record.value << 32;
+}
+
+// One record as a line: pc, opcode, mnemonic, the register it changed
+// ("+" if others changed too) and the stack depth after it.
+static std::string format_record(const Trace_record &record,
+                                 Platform platform) {
+  char line[96];
+  if (record.reg == TRACE_FRAME) {
+    snprintf(line, sizeof(line), "-- end of frame %" PRIu64,
+             frame_number(record));
+    return line;
+  }
+  const uint8_t reg = record.reg & TRACE_REG_MASK;
+  // F000 NNNN's address word isn't recorded, but it ends up in I
+  const std::string text = disassemble(
+      record.inst, reg == TRACE_REG_I ? record.value : 0, platform);
+  char change[16] = "-";
+  if (reg < 16) {
+    snprintf(change, sizeof(change), "V%X=%02X", reg, record.value);
+  } else if (reg == TRACE_REG_I) {
+    snprintf(change, sizeof(change), "I=%04X", record.value);
+  }
+  snprintf(line, sizeof(line), "%04X  %04X  %-20s %s%s sp=%u", record.pc,
+           record.inst, text.c_str(), change,
+           record.reg & TRACE_MORE ? "+" : "", record.sp);
+  return line;
+}
+
+static int print_trace(const char *path) {
+  Trace_reader trace(path);
+  if (!trace.ok()) {
+    std::cerr << "Can't read a trace from " << path << std::endl;
+    return 2;
+  }
+  const Platform platform = (Platform)trace.header.platform;
+  char header[96];
+  snprintf(header, sizeof(header), "; rom %016" PRIx64 ", platform %u, "
+                                   "quirks 0x%X",
+           trace.header.rom_hash, trace.header.platform,
+           trace.header.quirks);
+  std::cout << header << "\n";
+  Trace_record record;
+  while (trace.next(record)) {
+    std::cout << format_record(record, platform) << "\n";
+  }
+  return 0;
+}
+
+// Walks both traces in step and stops at the first record that differs,
+// showing what led up to it.
+static int diff_traces(const char *path_a, const char *path_b) {
+  Trace_reader a(path_a);
+  Trace_reader b(path_b);
+  if (!a.ok() || !b.ok()) {
+    std::cerr << "Can't read a trace from " << (a.ok() ? path_b : path_a)
+              << std::endl;
+    return 2;
+  }
+  if (a.header.rom_hash != b.header.rom_hash ||
+      a.header.platform != b.header.platform ||
+      a.header.quirks != b.header.quirks) {
+    std::cout << "; traces are of different ROMs or machines" << std::endl;
+  }
+  const Platform platform = (Platform)a.header.platform;
+
+  std::deque<Trace_record> context;
+  uint64_t index = 0;
+  uint64_t frame = 0; // frames finished before this record
+  Trace_record record_a;
+  Trace_record record_b;
+  while (true) {
+    const bool more_a = a.next(record_a);
+    const bool more_b = b.next(record_b);
+    if (!more_a && !more_b) {
+      std::cout << "identical, " << index << " records" << std::endl;
+      return 0;
+    }
+    if (more_a != more_b ||
+        memcmp(&record_a, &record_b, sizeof(Trace_record)) != 0) {
+      std::cout << "first difference at record " << index << ", in frame "
+                << frame + 1 << "\n";
+      for (const Trace_record &record : context) {
+        std::cout << "   " << format_record(record, platform) << "\n";
+      }
+      std::cout << "a: "
+                << (more_a ? format_record(record_a, platform) : "(end)")
+                << "\n";
+      std::cout << "b: "
+                << (more_b ? format_record(record_b, platform) : "(end)")
+                << std::endl;
+      return 1;
+    }
+    if (record_a.reg == TRACE_FRAME) {
+      frame = frame_number(record_a);
+    }
+    context.push_back(record_a);
+    if (context.size() > TRACE_CONTEXT) {
+      context.pop_front();
+    }
+    index++;
+  }
+}
+
+// Renders traces written by chip8_headless --trace, or finds where two of
+// them part ways. Exits 0 if the traces match, 1 if they differ, 2 on
+// errors, like diff.
+int main(int argc, char **argv) {
+  if (argc == 4 && strcmp(argv[1], "--diff") == 0) {
+    return diff_traces(argv[2], argv[3]);
+  }
+  if (argc == 2) {
+    return print_trace(argv[1]);
+  }
+  std::cerr << "Usage --- chip8_trace <trace> | chip8_trace --diff <a> <b>"
+            << std::endl;
+  return 2;
+}
@@ -0,0 +1,138 @@
+#include "movie.hpp"
+#include "timing.hpp"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+Movie::Movie() : header(), cursor(0) {}
+
+// Begins a recording of chip from power-on: seeds it and notes the ROM and
+// frame timing the recording depends on.
+void Movie::start(Chip8 &chip, uint32_t seed) {
+  chip.seed(seed);
+  this->header.magic = MOVIE_MAGIC;
+  this->header.version = MOVIE_VERSION;
+  this->header.rom_hash = chip.get_rom_hash();
+  this->header.seed = seed;
+  this->header.inst_per_frame = chip.get_config().inst_per_frame;
+  this->header.frames = 0;
+  this->header.event_count = 0;
+  this->header.timing = chip.get_config().timing;
+  this->header.cycles_per_frame = chip.get_config().cycles_per_frame;
+  this->header.quirks = chip.get_config().quirks;
+  this->header.platform = chip.get_config().platform;
+  this->events.clear();
+  this->cursor = 0;
+}
+
+// Call before each frame runs. Stores the keypad if it changed since the
+// last event.
+void Movie::record(const Chip8 &chip) {
+  const uint32_t frame = (uint32_t)chip.get_frame_count();
+  const uint16_t keys = chip.get_keys();
+  const uint16_t last = this->events.empty() ? 0 : this->events.back().keys;
+  if (keys == last) {
+    return;
+  }
+  if (!this->events.empty() && this->events.back().frame == frame) {
+    this->events.back().keys = keys;
+  } else {
+    this->events.push_back({frame, keys});
+  }
+}
+
+// Forgets input from frame on, e.g. after rewinding to it.
+void Movie::truncate(uint64_t frame) {
+  while (!this->events.empty() && this->events.back().frame >= frame) {
+    this->events.pop_back();
+  }
+}
+
+void Movie::finish(const Chip8 &chip) {
+  this->header.frames = chip.get_frame_count();
+  this->header.event_count = this->events.size();
+}
+
+// Call before each frame runs. Sets the keypad to what was recorded for
+// that frame.
+void Movie::play(Chip8 &chip) {
+  uint16_t keys;
+  if (this->keys_at(chip.get_frame_count(), keys)) {
+    chip.set_keys(keys);
+  }
+}
+
+// Same as play() for machines other than a Chip8: returns true and the
+// keypad in keys if it changes at frame.
+bool Movie::keys_at(uint64_t frame, uint16_t &keys) {
+  bool changed = false;
+  while (this->cursor < this->events.size() &&
+         this->events[this->cursor].frame <= frame) {
+    keys = this->events[this->cursor].keys;
+    changed = true;
+    this->cursor++;
+  }
+  return changed;
+}
+
+const Movie_header &Movie::get_header() const { return this->header; }
+
+bool Movie::save(const char *path) const {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  file.write(reinterpret_cast<const char *>(&this->header),
+             sizeof(this->header));
+  for (const Movie_event &event : this->events) {
+    uint8_t bytes[6];
+    memcpy(bytes, &event.frame, 4);
+    memcpy(bytes + 4, &event.keys, 2);
+    file.write(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+  }
+  return file.good();
+}
+
+bool Movie::load(const char *path) {
+  std::ifstream file(path, std::ios::binary);
+  Movie_header loaded;
+  if (!file.read(reinterpret_cast<char *>(&loaded), MOVIE_HEADER_V1_SIZE) ||
+      loaded.magic != MOVIE_MAGIC || loaded.version < 1 ||
+      loaded.version > MOVIE_VERSION) {
+    return false;
+  }
+  // Fields newer than the file's version keep their old meaning
+  static const size_t header_size[] = {0, MOVIE_HEADER_V1_SIZE,
+                                       MOVIE_HEADER_V2_SIZE,
+                                       sizeof(Movie_header)};
+  loaded.timing = TIMING_INSTRUCTIONS;
+  loaded.cycles_per_frame = VIP_CYCLES_PER_FRAME;
+  loaded.quirks = 0;
+  loaded.platform = PLATFORM_CHIP8;
+  const size_t size = header_size[loaded.version];
+  if (!file.read(reinterpret_cast<char *>(&loaded) + MOVIE_HEADER_V1_SIZE,
+                 size - MOVIE_HEADER_V1_SIZE)) {
+    return false;
+  }
+  // They index tables once the machine runs
+  if (loaded.platform > PLATFORM_XOCHIP || loaded.timing > TIMING_VIP) {
+    return false;
+  }
+
+  std::vector<Movie_event> loaded_events;
+  for (uint64_t n = 0; n < loaded.event_count; n++) {
+    uint8_t bytes[6];
+    if (!file.read(reinterpret_cast<char *>(bytes), sizeof(bytes))) {
+      return false;
+    }
+    Movie_event event;
+    memcpy(&event.frame, bytes, 4);
+    memcpy(&event.keys, bytes + 4, 2);
+    loaded_events.push_back(event);
+  }
+
+  this->header = loaded;
+  this->events.swap(loaded_events);
+  this->cursor = 0;
+  return true;
+}
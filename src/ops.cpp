@@ -0,0 +1,697 @@
+#include "chip8.hpp"
+#include "quirks.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+// Opcode handlers. Each one executes a single already decoded instruction;
+// pc has already been advanced past it by the caller. Handlers whose
+// behaviour depends on config.quirks or config.platform take them as
+// template arguments and test them with if constexpr.
+
+// Rows 0 to count - 1 as a dirty row mask.
+static inline uint64_t rows_mask(uint32_t count) {
+  return count >= 64 ? ~0ULL : (1ULL << count) - 1;
+}
+
+void Chip8::op_nop(const Instruction &) {
+  // No op
+}
+
+// Clears the selected planes.
+void Chip8::op_00E0(const Instruction &) {
+  const uint32_t height = resolution_height(this->resolution);
+  for (uint32_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+    if (!(this->planes & (1 << plane))) {
+      continue;
+    }
+    uint64_t(&halves)[2][DISPLAY_HEIGHT] = this->display[plane];
+    for (uint32_t row = 0; row < height; row++) {
+      if (halves[0][row] | halves[1][row]) {
+        this->frame_dirty |= 1ULL << row;
+      }
+      halves[0][row] = 0;
+      halves[1][row] = 0;
+    }
+  }
+}
+
+// Scrolls the selected planes by distance rows, down if positive. Whole
+// packed rows move, and rows scrolled in are blank.
+void Chip8::scroll_vertical(int32_t distance) {
+  const uint32_t height = resolution_height(this->resolution);
+  const uint32_t n = std::min((uint32_t)std::abs(distance), height);
+  for (uint32_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+    if (!(this->planes & (1 << plane))) {
+      continue;
+    }
+    for (uint64_t *rows : this->display[plane]) {
+      if (distance > 0) {
+        memmove(rows + n, rows, (height - n) * sizeof(*rows));
+        memset(rows, 0, n * sizeof(*rows));
+      } else {
+        memmove(rows, rows + n, (height - n) * sizeof(*rows));
+        memset(rows + height - n, 0, n * sizeof(*rows));
+      }
+    }
+  }
+  this->frame_dirty |= rows_mask(height);
+}
+
+// Scrolls the selected planes by distance columns, right if positive. Each
+// row is shifted as one 64 or 128-bit word.
+void Chip8::scroll_horizontal(int32_t distance) {
+  const uint32_t height = resolution_height(this->resolution);
+  const bool wide = this->resolution == RES_HIRES;
+  const uint32_t n = (uint32_t)std::abs(distance); // 1 to 63
+  for (uint32_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+    if (!(this->planes & (1 << plane))) {
+      continue;
+    }
+    uint64_t(&halves)[2][DISPLAY_HEIGHT] = this->display[plane];
+    for (uint32_t row = 0; row < height; row++) {
+      uint64_t &left = halves[0][row];
+      uint64_t &right = halves[1][row];
+      if (distance > 0) {
+        right = wide ? (right >> n) | (left << (64 - n)) : 0;
+        left >>= n;
+      } else {
+        left = (left << n) | (wide ? right >> (64 - n) : 0);
+        right = wide ? right << n : 0;
+      }
+    }
+  }
+  this->frame_dirty |= rows_mask(height);
+}
+
+// Switching modes clears the screen, every plane.
+void Chip8::set_resolution(Resolution resolution) {
+  this->resolution = resolution;
+  memset(this->display, 0, sizeof(this->display));
+  this->frame_dirty |= ~0ULL;
+}
+
+void Chip8::op_00CN(const Instruction &op) { this->scroll_vertical(op.n); }
+
+void Chip8::op_00DN(const Instruction &op) { this->scroll_vertical(-op.n); }
+
+void Chip8::op_00EE(const Instruction &) {
+  if (this->sp > 0) {
+    this->sp--;
+    this->pc = this->stack[this->sp];
+    PROFILE_RETURN(this->profiler);
+  } else {
+    this->state = EmuState::PAUSED;
+  }
+}
+
+void Chip8::op_00FB(const Instruction &) { this->scroll_horizontal(4); }
+
+void Chip8::op_00FC(const Instruction &) { this->scroll_horizontal(-4); }
+
+// SUPER-CHIP's exit. There is nothing to return to, so the machine stops.
+void Chip8::op_00FD(const Instruction &) { this->state = EmuState::PAUSED; }
+
+void Chip8::op_00FE(const Instruction &) { this->set_resolution(RES_LORES); }
+
+void Chip8::op_00FF(const Instruction &) { this->set_resolution(RES_HIRES); }
+
+// Two-page hires clear screen, a machine code call anywhere else.
+void Chip8::op_0230(const Instruction &op) {
+  if (this->resolution == RES_TALL) {
+    this->op_00E0(op);
+  }
+}
+
+void Chip8::op_1NNN(const Instruction &op) { this->pc = op.nnn; }
+
+// Two-page hires ROMs start with a jump over the VIP interpreter patch
+// they carry. Taken as the first instruction it switches to 64x64 and
+// enters the program proper at 0x2C0.
+void Chip8::op_1260(const Instruction &op) {
+  if (this->pc == 0x202) {
+    this->set_resolution(RES_TALL);
+    this->pc = 0x2C0;
+  } else {
+    this->pc = op.nnn;
+  }
+}
+
+void Chip8::op_2NNN(const Instruction &op) {
+  if (this->sp < this->stack_size - 1) {
+    this->stack[this->sp] = this->pc;
+    this->sp++;
+    this->pc = op.nnn;
+    PROFILE_CALL(this->profiler, this->stack[this->sp - 1] - 2, op.nnn);
+  } else {
+    this->state = EmuState::PAUSED;
+  }
+}
+
+// Skips the next instruction. XO-CHIP's F000 NNNN is four bytes long, so
+// there the skip has to look at what it skips.
+template <Platform platform> void Chip8::skip() {
+  if constexpr (platform == PLATFORM_XOCHIP) {
+    if (this->mem[this->pc] == 0xF0 &&
+        this->mem[(this->pc + 1) & (MEM_SIZE - 1)] == 0x00) {
+      this->pc += 4;
+      return;
+    }
+  }
+  this->pc += 2;
+}
+
+template <Platform platform> void Chip8::op_3XNN(const Instruction &op) {
+  if (this->gpr[op.x] == op.nn) {
+    this->skip<platform>();
+  }
+}
+
+template <Platform platform> void Chip8::op_4XNN(const Instruction &op) {
+  if (this->gpr[op.x] != op.nn) {
+    this->skip<platform>();
+  }
+}
+
+template <Platform platform> void Chip8::op_5XY0(const Instruction &op) {
+  if (this->gpr[op.x] == this->gpr[op.y]) {
+    this->skip<platform>();
+  }
+}
+
+// Stores VX to VY at I, in that order even when X > Y. I is unchanged.
+void Chip8::op_5XY2(const Instruction &op) {
+  const int32_t step = op.x <= op.y ? 1 : -1;
+  const uint32_t count = std::abs(op.x - op.y) + 1;
+  for (uint32_t n = 0; n < count; n++) {
+    this->write_mem(this->i + n, this->gpr[op.x + step * (int32_t)n]);
+  }
+}
+
+// Loads VX to VY from I, like 5XY2.
+void Chip8::op_5XY3(const Instruction &op) {
+  const int32_t step = op.x <= op.y ? 1 : -1;
+  const uint32_t count = std::abs(op.x - op.y) + 1;
+  for (uint32_t n = 0; n < count; n++) {
+    this->gpr[op.x + step * (int32_t)n] =
+        this->mem[(this->i + n) & (MEM_SIZE - 1)];
+  }
+}
+
+void Chip8::op_6XNN(const Instruction &op) { this->gpr[op.x] = op.nn; }
+
+void Chip8::op_7XNN(const Instruction &op) { this->gpr[op.x] += op.nn; }
+
+void Chip8::op_8XY0(const Instruction &op) {
+  this->gpr[op.x] = this->gpr[op.y];
+}
+
+template <uint32_t quirks> void Chip8::op_8XY1(const Instruction &op) {
+  this->gpr[op.x] |= this->gpr[op.y];
+  if constexpr (quirks & QUIRK_VF_RESET) {
+    this->gpr[0xF] = 0;
+  }
+}
+
+template <uint32_t quirks> void Chip8::op_8XY2(const Instruction &op) {
+  this->gpr[op.x] &= this->gpr[op.y];
+  if constexpr (quirks & QUIRK_VF_RESET) {
+    this->gpr[0xF] = 0;
+  }
+}
+
+template <uint32_t quirks> void Chip8::op_8XY3(const Instruction &op) {
+  this->gpr[op.x] ^= this->gpr[op.y];
+  if constexpr (quirks & QUIRK_VF_RESET) {
+    this->gpr[0xF] = 0;
+  }
+}
+
+void Chip8::op_8XY4(const Instruction &op) {
+  uint16_t sum = (uint16_t)this->gpr[op.x] + this->gpr[op.y];
+  this->gpr[op.x] = (uint8_t)sum;
+  if (sum > 0xFF) {
+    this->gpr[0xF] = 1;
+  } else {
+    this->gpr[0xF] = 0;
+  }
+}
+
+// VF is written last in all of these, so the flag survives when X is F.
+void Chip8::op_8XY5(const Instruction &op) {
+  const uint8_t no_borrow = this->gpr[op.x] >= this->gpr[op.y];
+  this->gpr[op.x] = this->gpr[op.x] - this->gpr[op.y];
+  this->gpr[0xF] = no_borrow;
+}
+
+template <uint32_t quirks> void Chip8::op_8XY6(const Instruction &op) {
+  uint8_t source = this->gpr[op.x];
+  if constexpr (quirks & QUIRK_SHIFT_VY) {
+    source = this->gpr[op.y];
+  }
+  this->gpr[op.x] = source >> 1;
+  this->gpr[0xF] = source & 0x01;
+}
+
+void Chip8::op_8XY7(const Instruction &op) {
+  const uint8_t no_borrow = this->gpr[op.y] >= this->gpr[op.x];
+  this->gpr[op.x] = this->gpr[op.y] - this->gpr[op.x];
+  this->gpr[0xF] = no_borrow;
+}
+
+template <uint32_t quirks> void Chip8::op_8XYE(const Instruction &op) {
+  uint8_t source = this->gpr[op.x];
+  if constexpr (quirks & QUIRK_SHIFT_VY) {
+    source = this->gpr[op.y];
+  }
+  this->gpr[op.x] = source << 1;
+  this->gpr[0xF] = source >> 7;
+}
+
+template <Platform platform> void Chip8::op_9XY0(const Instruction &op) {
+  if (this->gpr[op.x] != this->gpr[op.y]) {
+    this->skip<platform>();
+  }
+}
+
+void Chip8::op_ANNN(const Instruction &op) { this->i = op.nnn; }
+
+template <uint32_t quirks> void Chip8::op_BNNN(const Instruction &op) {
+  if constexpr (quirks & QUIRK_JUMP_VX) {
+    this->pc = op.nnn + this->gpr[op.x];
+  } else {
+    this->pc = op.nnn + this->gpr[0];
+  }
+}
+
+void Chip8::op_CXNN(const Instruction &op) {
+  this->gpr[op.x] = this->random_byte() & op.nn;
+}
+
+// Each sprite row is shifted into place and XORed into the packed display
+// row in one go; collision is a single AND against what was there. Plain
+// 64x32 single plane drawing takes this path, everything else draw_sprite.
+template <uint32_t quirks, Platform platform>
+void Chip8::op_DXYN(const Instruction &op) {
+  if (this->resolution != RES_LORES || this->planes != 1 ||
+      (op.n == 0 &&
+       (platform == PLATFORM_SCHIP || platform == PLATFORM_XOCHIP))) {
+    this->draw_sprite<quirks, platform>(op);
+    return;
+  }
+
+  uint8_t x = this->gpr[op.x] % 64;
+  uint8_t y = this->gpr[op.y] % 32;
+  uint8_t height = op.n;
+  uint64_t *display = this->display[0][0];
+
+  // Columns past config.width are clipped
+  const uint64_t clip =
+      this->config.width >= 64 ? ~0ULL : ~(~0ULL >> this->config.width);
+
+  this->gpr[0xF] = 0;
+
+  for (uint8_t row = 0; row < height; row++) {
+    if ((size_t)this->i + row >= this->mem_size) {
+      break;
+    }
+    uint8_t curr_y = y + row;
+    if (curr_y >= this->config.height) {
+      if constexpr (quirks & QUIRK_WRAP) {
+        curr_y %= this->config.height;
+      } else {
+        break;
+      }
+    }
+
+    const uint64_t sprite_byte = this->mem[this->i + row];
+    uint64_t bits;
+    if constexpr (quirks & QUIRK_WRAP) {
+      bits = std::rotr(sprite_byte << 56, x) & clip;
+    } else {
+      bits = (x <= 56 ? sprite_byte << (56 - x) : sprite_byte >> (x - 56)) &
+             clip;
+    }
+
+    if (display[curr_y] & bits) {
+      this->gpr[0xF] = 1;
+    }
+    display[curr_y] ^= bits;
+    if (bits) {
+      this->frame_dirty |= 1ULL << curr_y;
+    }
+  }
+
+  if constexpr (quirks & QUIRK_DISPLAY_WAIT) {
+    this->vblank_wait = true;
+  }
+}
+
+// DXYN in any mode and on any planes. Rows are up to 16 bits (DXY0 draws
+// 16x16 on SUPER-CHIP and XO-CHIP), placed across the two 64-bit halves of
+// a display row with a pair of shifts. Each selected plane takes the next
+// sprite from I on. VF is set if any pixel of any plane was erased.
+template <uint32_t quirks, Platform platform>
+void Chip8::draw_sprite(const Instruction &op) {
+  const uint32_t width = resolution_width(this->resolution);
+  const uint32_t height = resolution_height(this->resolution);
+  const uint32_t x = this->gpr[op.x] & (width - 1);
+  const uint32_t y = this->gpr[op.y] & (height - 1);
+  const bool big = op.n == 0 && (platform == PLATFORM_SCHIP ||
+                                 platform == PLATFORM_XOCHIP);
+  const uint32_t rows = big ? 16 : op.n;
+  const uint32_t row_bytes = big ? 2 : 1;
+
+  bool collided = false;
+  uint32_t addr = this->i;
+  for (uint32_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+    if (!(this->planes & (1 << plane))) {
+      continue;
+    }
+    uint64_t(&halves)[2][DISPLAY_HEIGHT] = this->display[plane];
+    for (uint32_t row = 0; row < rows; row++, addr += row_bytes) {
+      uint32_t curr_y = y + row;
+      if (curr_y >= height) {
+        if constexpr (quirks & QUIRK_WRAP) {
+          curr_y -= height;
+        } else {
+          continue; // still step addr past the clipped rows
+        }
+      }
+
+      uint64_t sprite = 0;
+      for (uint32_t byte = 0; byte < row_bytes; byte++) {
+        const uint32_t at = addr + byte;
+        sprite = sprite << 8 | (at < this->mem_size ? this->mem[at] : 0);
+      }
+      const uint64_t bits = sprite << (64 - 8 * row_bytes);
+
+      uint64_t left, right;
+      if (width == 64) {
+        if constexpr (quirks & QUIRK_WRAP) {
+          left = std::rotr(bits, x);
+        } else {
+          left = bits >> x;
+        }
+        right = 0;
+      } else {
+        left = x < 64 ? bits >> x : 0;
+        right = x == 0 ? 0 : x < 64 ? bits << (64 - x) : bits >> (x - 64);
+        if constexpr (quirks & QUIRK_WRAP) {
+          if (x > 64) {
+            left |= bits << (128 - x); // past column 127
+          }
+        }
+      }
+
+      if ((halves[0][curr_y] & left) | (halves[1][curr_y] & right)) {
+        collided = true;
+      }
+      halves[0][curr_y] ^= left;
+      halves[1][curr_y] ^= right;
+      if (left | right) {
+        this->frame_dirty |= 1ULL << curr_y;
+      }
+    }
+  }
+  this->gpr[0xF] = collided;
+
+  if constexpr (quirks & QUIRK_DISPLAY_WAIT) {
+    this->vblank_wait = true;
+  }
+}
+
+template <Platform platform> void Chip8::op_EX9E(const Instruction &op) {
+  if (this->keypad[this->gpr[op.x] & 0xF]) {
+    this->skip<platform>();
+  }
+}
+
+template <Platform platform> void Chip8::op_EXA1(const Instruction &op) {
+  if (!this->keypad[this->gpr[op.x] & 0xF]) {
+    this->skip<platform>();
+  }
+}
+
+// XO-CHIP's long I load: NNNN is the next word. pc moves past it.
+void Chip8::op_F000(const Instruction &) {
+  this->i = (this->mem[this->pc] << 8) |
+            this->mem[(this->pc + 1) & (MEM_SIZE - 1)];
+  this->pc += 2;
+}
+
+// Selects the planes later DXYN, 00E0 and scrolls apply to. The plane mask
+// sits in X.
+void Chip8::op_FN01(const Instruction &op) {
+  this->planes = op.x & ((1 << DISPLAY_PLANES) - 1);
+}
+
+void Chip8::op_F002(const Instruction &) {
+  for (uint32_t byte = 0; byte < sizeof(this->pattern); byte++) {
+    this->pattern[byte] = this->mem[(this->i + byte) & (MEM_SIZE - 1)];
+  }
+}
+
+void Chip8::op_FX07(const Instruction &op) { this->gpr[op.x] = this->delay; }
+
+void Chip8::op_FX0A(const Instruction &op) {
+  bool pressed = false;
+  for (uint8_t i = 0; i < sizeof(this->keypad) / sizeof(this->keypad[0]);
+       i++) {
+    if (this->keypad[i]) {
+      this->gpr[op.x] = i;
+      pressed = true;
+      break;
+    }
+  }
+  if (!pressed) {
+    this->pc -= 2;
+  }
+}
+
+void Chip8::op_FX15(const Instruction &op) { this->delay = this->gpr[op.x]; }
+
+void Chip8::op_FX18(const Instruction &op) { this->sound = this->gpr[op.x]; }
+
+void Chip8::op_FX1E(const Instruction &op) {
+  this->i += this->gpr[op.x];
+}
+
+void Chip8::op_FX29(const Instruction &op) {
+  this->i = (this->gpr[op.x] & 0xF) * 5 + 0x050;
+}
+
+void Chip8::op_FX30(const Instruction &op) {
+  this->i = (this->gpr[op.x] & 0xF) * 10 + BIG_FONT_ADDR;
+}
+
+// Hundreds at I, tens at I + 1, ones at I + 2.
+void Chip8::op_FX33(const Instruction &op) {
+  const uint8_t num = this->gpr[op.x];
+  this->write_mem(this->i, num / 100);
+  this->write_mem(this->i + 1, num / 10 % 10);
+  this->write_mem(this->i + 2, num % 10);
+}
+
+void Chip8::op_FX3A(const Instruction &op) { this->pitch = this->gpr[op.x]; }
+
+template <uint32_t quirks> void Chip8::op_FX55(const Instruction &op) {
+  for (uint8_t offset = 0; offset <= op.x; offset++) {
+    this->write_mem(this->i + offset, this->gpr[offset]);
+  }
+  if constexpr (quirks & QUIRK_LOAD_STORE_I) {
+    this->i += op.x + 1;
+  }
+}
+
+template <uint32_t quirks> void Chip8::op_FX65(const Instruction &op) {
+  for (uint8_t offset = 0; offset <= op.x; offset++) {
+    const uint32_t addr = this->i + offset;
+    this->gpr[offset] = addr < this->mem_size ? this->mem[addr] : 0;
+  }
+  if constexpr (quirks & QUIRK_LOAD_STORE_I) {
+    this->i += op.x + 1;
+  }
+}
+
+// SUPER-CHIP had 8 flag registers, XO-CHIP has 16.
+void Chip8::op_FX75(const Instruction &op) {
+  memcpy(this->rpl, this->gpr, op.x + 1);
+}
+
+void Chip8::op_FX85(const Instruction &op) {
+  memcpy(this->gpr, this->rpl, op.x + 1);
+}
+
+// Splits an opcode into its operand fields.
+Instruction Chip8::split(uint16_t inst) {
+  Instruction op;
+  op.inst = inst;
+  op.nnn = inst & 0x0FFF;
+  op.nn = inst & 0x00FF;
+  op.n = inst & 0x000F;
+  op.x = (inst & 0x0F00) >> 8;
+  op.y = (inst & 0x00F0) >> 4;
+  return op;
+}
+
+// Maps an opcode to the handler that executes it on platform under quirks.
+// Opcodes a platform doesn't have are no-ops.
+template <Platform platform, uint32_t quirks>
+Handler Chip8::decode(uint16_t inst) {
+  constexpr bool hires = platform == PLATFORM_CHIP8_HIRES;
+  constexpr bool super =
+      platform == PLATFORM_SCHIP || platform == PLATFORM_XOCHIP;
+  constexpr bool xo = platform == PLATFORM_XOCHIP;
+
+  switch ((inst >> 12) & 0x0F) {
+  case 0x00:
+    if (super && (inst & 0xFFF0) == 0x00C0) {
+      return &dispatch<&Chip8::op_00CN>;
+    }
+    if (xo && (inst & 0xFFF0) == 0x00D0) {
+      return &dispatch<&Chip8::op_00DN>;
+    }
+    if (hires && inst == 0x0230) {
+      return &dispatch<&Chip8::op_0230>;
+    }
+    switch (inst & 0x00FF) {
+    case 0xE0:
+      return &dispatch<&Chip8::op_00E0>;
+    case 0xEE:
+      return &dispatch<&Chip8::op_00EE>;
+    case 0xFB:
+      return super ? &dispatch<&Chip8::op_00FB> : &dispatch<&Chip8::op_nop>;
+    case 0xFC:
+      return super ? &dispatch<&Chip8::op_00FC> : &dispatch<&Chip8::op_nop>;
+    case 0xFD:
+      return super ? &dispatch<&Chip8::op_00FD> : &dispatch<&Chip8::op_nop>;
+    case 0xFE:
+      return super ? &dispatch<&Chip8::op_00FE> : &dispatch<&Chip8::op_nop>;
+    case 0xFF:
+      return super ? &dispatch<&Chip8::op_00FF> : &dispatch<&Chip8::op_nop>;
+    default:
+      return &dispatch<&Chip8::op_nop>;
+    }
+  case 0x01:
+    if (hires && inst == 0x1260) {
+      return &dispatch<&Chip8::op_1260>;
+    }
+    return &dispatch<&Chip8::op_1NNN>;
+  case 0x02:
+    return &dispatch<&Chip8::op_2NNN>;
+  case 0x03:
+    return &dispatch<&Chip8::op_3XNN<platform>>;
+  case 0x04:
+    return &dispatch<&Chip8::op_4XNN<platform>>;
+  case 0x05:
+    if (xo && (inst & 0x000F) == 0x2) {
+      return &dispatch<&Chip8::op_5XY2>;
+    }
+    if (xo && (inst & 0x000F) == 0x3) {
+      return &dispatch<&Chip8::op_5XY3>;
+    }
+    return &dispatch<&Chip8::op_5XY0<platform>>;
+  case 0x06:
+    return &dispatch<&Chip8::op_6XNN>;
+  case 0x07:
+    return &dispatch<&Chip8::op_7XNN>;
+  case 0x08:
+    switch (inst & 0x000F) {
+    case 0x0:
+      return &dispatch<&Chip8::op_8XY0>;
+    case 0x1:
+      return &dispatch<&Chip8::op_8XY1<quirks>>;
+    case 0x2:
+      return &dispatch<&Chip8::op_8XY2<quirks>>;
+    case 0x3:
+      return &dispatch<&Chip8::op_8XY3<quirks>>;
+    case 0x4:
+      return &dispatch<&Chip8::op_8XY4>;
+    case 0x5:
+      return &dispatch<&Chip8::op_8XY5>;
+    case 0x6:
+      return &dispatch<&Chip8::op_8XY6<quirks>>;
+    case 0x7:
+      return &dispatch<&Chip8::op_8XY7>;
+    case 0xE:
+      return &dispatch<&Chip8::op_8XYE<quirks>>;
+    default:
+      return &dispatch<&Chip8::op_nop>;
+    }
+  case 0x09:
+    return &dispatch<&Chip8::op_9XY0<platform>>;
+  case 0x0A:
+    return &dispatch<&Chip8::op_ANNN>;
+  case 0x0B:
+    return &dispatch<&Chip8::op_BNNN<quirks>>;
+  case 0x0C:
+    return &dispatch<&Chip8::op_CXNN>;
+  case 0x0D:
+    return &dispatch<&Chip8::op_DXYN<quirks, platform>>;
+  case 0x0E:
+    switch (inst & 0x00FF) {
+    case 0x9E:
+      return &dispatch<&Chip8::op_EX9E<platform>>;
+    case 0xA1:
+      return &dispatch<&Chip8::op_EXA1<platform>>;
+    default:
+      return &dispatch<&Chip8::op_nop>;
+    }
+  default: // 0x0F
+    if (xo && inst == 0xF000) {
+      return &dispatch<&Chip8::op_F000>;
+    }
+    if (xo && inst == 0xF002) {
+      return &dispatch<&Chip8::op_F002>;
+    }
+    switch (inst & 0x00FF) {
+    case 0x01:
+      return xo ? &dispatch<&Chip8::op_FN01> : &dispatch<&Chip8::op_nop>;
+    case 0x07:
+      return &dispatch<&Chip8::op_FX07>;
+    case 0x0A:
+      return &dispatch<&Chip8::op_FX0A>;
+    case 0x15:
+      return &dispatch<&Chip8::op_FX15>;
+    case 0x18:
+      return &dispatch<&Chip8::op_FX18>;
+    case 0x1E:
+      return &dispatch<&Chip8::op_FX1E>;
+    case 0x29:
+      return &dispatch<&Chip8::op_FX29>;
+    case 0x30:
+      return super ? &dispatch<&Chip8::op_FX30> : &dispatch<&Chip8::op_nop>;
+    case 0x33:
+      return &dispatch<&Chip8::op_FX33>;
+    case 0x3A:
+      return xo ? &dispatch<&Chip8::op_FX3A> : &dispatch<&Chip8::op_nop>;
+    case 0x55:
+      return &dispatch<&Chip8::op_FX55<quirks>>;
+    case 0x65:
+      return &dispatch<&Chip8::op_FX65<quirks>>;
+    case 0x75:
+      return super ? &dispatch<&Chip8::op_FX75> : &dispatch<&Chip8::op_nop>;
+    case 0x85:
+      return super ? &dispatch<&Chip8::op_FX85> : &dispatch<&Chip8::op_nop>;
+    default:
+      return &dispatch<&Chip8::op_nop>;
+    }
+  }
+}
+
+// Every platform and quirk set gets its own decode<> instantiation, picked
+// once when they are set.
+Decoder Chip8::decoder_for(Platform platform, uint32_t quirks) {
+  static constexpr uint32_t sets = QUIRK_ALL + 1;
+  static constexpr auto decoders =
+      []<uint32_t... n>(std::integer_sequence<uint32_t, n...>) {
+        return std::array<Decoder, sizeof...(n)>{
+            &decode<(Platform)(n / sets), n % sets>...};
+      }(std::make_integer_sequence<uint32_t, (PLATFORM_XOCHIP + 1) * sets>());
+  return decoders[platform * sets + (quirks & QUIRK_ALL)];
+}
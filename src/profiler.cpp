@@ -0,0 +1,184 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+
+#define PROFILE_MAX_PCS 256 // hottest pcs listed in the JSON report
+
+Profiler::Profiler()
+    : opcode_counts(0x10000), pc_counts(0x10000), current(0),
+      idle_skipped(0), section_ns() {
+  this->frames.push_back({0x200, 0, 0});
+}
+
+// 2NNN at site entered target. Calls to the same target from the same
+// function share a frame in the call tree.
+void Profiler::call(uint16_t site, uint16_t target) {
+  this->call_edges[(uint32_t)site << 16 | target]++;
+  const uint64_t key = (uint64_t)this->current << 16 | target;
+  auto child = this->children.find(key);
+  if (child == this->children.end()) {
+    const uint32_t frame = (uint32_t)this->frames.size();
+    this->frames.push_back({target, this->current, 0});
+    child = this->children.emplace(key, frame).first;
+  }
+  this->current = child->second;
+}
+
+void Profiler::ret() {
+  this->current = this->frames[this->current].parent;
+}
+
+// The machine's stack was replaced (a state was loaded), so calls made so
+// far no longer match it. Execution is charged to the root from here until
+// the next call.
+void Profiler::lost_stack() { this->current = 0; }
+
+void Profiler::skipped(uint64_t count) { this->idle_skipped += count; }
+
+void Profiler::add_time(Profile_section section, uint64_t ns) {
+  this->section_ns[section] += ns;
+}
+
+// Opcode classes reports group counts by, first match wins
+static const struct {
+  uint16_t mask;
+  uint16_t value;
+  const char *name;
+} opcode_classes[] = {
+    {0xFFFF, 0x00E0, "00E0"}, {0xFFFF, 0x00EE, "00EE"},
+    {0xFFF0, 0x00C0, "00CN"}, {0xFFF0, 0x00D0, "00DN"},
+    {0xFFFF, 0x00FB, "00FB"}, {0xFFFF, 0x00FC, "00FC"},
+    {0xFFFF, 0x00FD, "00FD"}, {0xFFFF, 0x00FE, "00FE"},
+    {0xFFFF, 0x00FF, "00FF"}, {0xF000, 0x0000, "0NNN"},
+    {0xF000, 0x1000, "1NNN"}, {0xF000, 0x2000, "2NNN"},
+    {0xF000, 0x3000, "3XNN"}, {0xF000, 0x4000, "4XNN"},
+    {0xF00F, 0x5000, "5XY0"}, {0xF00F, 0x5002, "5XY2"},
+    {0xF00F, 0x5003, "5XY3"}, {0xF000, 0x6000, "6XNN"},
+    {0xF000, 0x7000, "7XNN"}, {0xF00F, 0x8000, "8XY0"},
+    {0xF00F, 0x8001, "8XY1"}, {0xF00F, 0x8002, "8XY2"},
+    {0xF00F, 0x8003, "8XY3"}, {0xF00F, 0x8004, "8XY4"},
+    {0xF00F, 0x8005, "8XY5"}, {0xF00F, 0x8006, "8XY6"},
+    {0xF00F, 0x8007, "8XY7"}, {0xF00F, 0x800E, "8XYE"},
+    {0xF00F, 0x9000, "9XY0"}, {0xF000, 0xA000, "ANNN"},
+    {0xF000, 0xB000, "BNNN"}, {0xF000, 0xC000, "CXNN"},
+    {0xF00F, 0xD000, "DXY0"}, {0xF000, 0xD000, "DXYN"},
+    {0xF0FF, 0xE09E, "EX9E"}, {0xF0FF, 0xE0A1, "EXA1"},
+    {0xFFFF, 0xF000, "F000"}, {0xFFFF, 0xF002, "F002"},
+    {0xF0FF, 0xF001, "FN01"}, {0xF0FF, 0xF007, "FX07"},
+    {0xF0FF, 0xF00A, "FX0A"}, {0xF0FF, 0xF015, "FX15"},
+    {0xF0FF, 0xF018, "FX18"}, {0xF0FF, 0xF01E, "FX1E"},
+    {0xF0FF, 0xF029, "FX29"}, {0xF0FF, 0xF030, "FX30"},
+    {0xF0FF, 0xF033, "FX33"}, {0xF0FF, 0xF03A, "FX3A"},
+    {0xF0FF, 0xF055, "FX55"}, {0xF0FF, 0xF065, "FX65"},
+    {0xF0FF, 0xF075, "FX75"}, {0xF0FF, 0xF085, "FX85"},
+};
+
+static const char *opcode_class(uint16_t inst) {
+  for (const auto &entry : opcode_classes) {
+    if ((inst & entry.mask) == entry.value) {
+      return entry.name;
+    }
+  }
+  return "other";
+}
+
+static std::string hex(uint32_t value) {
+  char text[16];
+  snprintf(text, sizeof(text), "0x%03X", value);
+  return text;
+}
+
+// Counts sorted by count, highest first, ties by key
+template <typename Key>
+static std::vector<std::pair<Key, uint64_t>>
+by_count(const std::map<Key, uint64_t> &counts) {
+  std::vector<std::pair<Key, uint64_t>> sorted(counts.begin(), counts.end());
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const auto &a, const auto &b) {
+                     return a.second > b.second;
+                   });
+  return sorted;
+}
+
+void Profiler::write_json(std::ostream &out) const {
+  static const char *section_names[PROFILE_SECTIONS] = {"execute", "timers",
+                                                        "input", "present"};
+  uint64_t instructions = 0;
+  std::map<std::string, uint64_t> classes;
+  std::map<uint32_t, uint64_t> pcs;
+  for (uint32_t n = 0; n < 0x10000; n++) {
+    if (this->opcode_counts[n] != 0) {
+      classes[opcode_class((uint16_t)n)] += this->opcode_counts[n];
+      instructions += this->opcode_counts[n];
+    }
+    if (this->pc_counts[n] != 0) {
+      pcs[n] = this->pc_counts[n];
+    }
+  }
+  const std::map<uint32_t, uint64_t> edges(this->call_edges.begin(),
+                                           this->call_edges.end());
+
+  out << "{\n  \"instructions\": " << instructions << ",\n";
+  out << "  \"idle_skipped\": " << this->idle_skipped << ",\n";
+  out << "  \"sections_ns\": {";
+  for (uint32_t section = 0; section < PROFILE_SECTIONS; section++) {
+    out << (section ? ", " : "") << "\"" << section_names[section]
+        << "\": " << this->section_ns[section];
+  }
+  out << "},\n  \"opcodes\": [";
+  bool first = true;
+  for (const auto &[name, count] : by_count(classes)) {
+    out << (first ? "\n" : ",\n") << "    {\"class\": \"" << name
+        << "\", \"count\": " << count << "}";
+    first = false;
+  }
+  out << "\n  ],\n  \"pcs\": [";
+  first = true;
+  uint32_t listed = 0;
+  for (const auto &[pc, count] : by_count(pcs)) {
+    if (listed++ == PROFILE_MAX_PCS) {
+      break;
+    }
+    out << (first ? "\n" : ",\n") << "    {\"pc\": \"" << hex(pc)
+        << "\", \"count\": " << count << "}";
+    first = false;
+  }
+  out << "\n  ],\n  \"calls\": [";
+  first = true;
+  for (const auto &[edge, count] : by_count(edges)) {
+    out << (first ? "\n" : ",\n") << "    {\"site\": \"" << hex(edge >> 16)
+        << "\", \"target\": \"" << hex(edge & 0xFFFF)
+        << "\", \"count\": " << count << "}";
+    first = false;
+  }
+  out << "\n  ]\n}\n";
+}
+
+// One line per call stack, "0x200;0x2A4;0x31C count", the format flame
+// graph tools read. Each function is named by its entry address.
+void Profiler::write_collapsed(std::ostream &out) const {
+  for (uint32_t frame = 0; frame < this->frames.size(); frame++) {
+    if (this->frames[frame].count == 0) {
+      continue;
+    }
+    std::string stack = hex(this->frames[frame].addr);
+    for (uint32_t up = frame; up != 0;) {
+      up = this->frames[up].parent;
+      stack = hex(this->frames[up].addr) + ";" + stack;
+    }
+    out << stack << " " << this->frames[frame].count << "\n";
+  }
+}
+
+bool save_profile(const char *prefix, const Profiler &profiler) {
+  std::ofstream json(std::string(prefix) + ".json");
+  profiler.write_json(json);
+  std::ofstream folded(std::string(prefix) + ".folded");
+  profiler.write_collapsed(folded);
+  return json.good() && folded.good();
+}
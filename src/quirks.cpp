@@ -0,0 +1,103 @@
+#include "quirks.hpp"
+#include <cstdint>
+#include <cstring>
+
+uint32_t profile_quirks(Profile profile) {
+  switch (profile) {
+  case PROFILE_CHIP8:
+  case PROFILE_CHIP8_HIRES:
+    return QUIRK_SHIFT_VY | QUIRK_LOAD_STORE_I | QUIRK_VF_RESET |
+           QUIRK_DISPLAY_WAIT;
+  case PROFILE_SCHIP:
+    return QUIRK_JUMP_VX;
+  case PROFILE_XOCHIP:
+    return QUIRK_SHIFT_VY | QUIRK_LOAD_STORE_I | QUIRK_WRAP;
+  default:
+    return 0;
+  }
+}
+
+Platform profile_platform(Profile profile) {
+  switch (profile) {
+  case PROFILE_CHIP8_HIRES:
+    return PLATFORM_CHIP8_HIRES;
+  case PROFILE_SCHIP:
+    return PLATFORM_SCHIP;
+  case PROFILE_XOCHIP:
+    return PLATFORM_XOCHIP;
+  default:
+    return PLATFORM_CHIP8;
+  }
+}
+
+static const struct {
+  const char *name;
+  Profile profile;
+} profile_names[] = {
+    {"default", PROFILE_DEFAULT},
+    {"chip8", PROFILE_CHIP8},
+    {"chip8hires", PROFILE_CHIP8_HIRES},
+    {"schip", PROFILE_SCHIP},
+    {"xochip", PROFILE_XOCHIP},
+};
+
+bool parse_profile(const char *name, Profile &profile) {
+  for (const auto &entry : profile_names) {
+    if (strcmp(name, entry.name) == 0) {
+      profile = entry.profile;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *profile_name(Profile profile) {
+  for (const auto &entry : profile_names) {
+    if (entry.profile == profile) {
+      return entry.name;
+    }
+  }
+  return "default";
+}
+
+// ROMs whose notes in chip8-roms say what they were written for: programs
+// published for the VIP, two-page hires programs, and programs written for
+// CHIP-48.
+static const struct {
+  uint64_t rom_hash;
+  Profile profile;
+} known_roms[] = {
+    {0x4136390c5e362b68ULL, PROFILE_CHIP8}, // Animal Race [Brian Astle]
+    {0x3a88eb66f94c1482ULL, PROFILE_CHIP8}, // Biorhythm [Jef Winsor]
+    {0x267a104f24f72a67ULL, PROFILE_CHIP8}, // Bowling [Gooitzen van der Wal]
+    {0xdd723d5d3554d0b9ULL, PROFILE_CHIP8}, // Deflection [John Fort]
+    {0xd4911604c3f935c7ULL, PROFILE_CHIP8}, // Kaleidoscope [Weisbecker, 1978]
+    {0x8bdf18db083ef860ULL, PROFILE_CHIP8}, // Lunar Lander (Pernisz, 1979)
+    {0xc1799734d41fd3f5ULL, PROFILE_CHIP8}, // Mastermind FourRow (1978)
+    {0xae490f9b88d6df33ULL, PROFILE_CHIP8}, // Most Dangerous Game
+    {0x2ee3a4a2d183c87eULL, PROFILE_CHIP8}, // Programmable Spacefighters
+    {0x52e23a5fddfd6062ULL, PROFILE_CHIP8}, // Reversi [Philip Baltzer]
+    {0xd1ae8ca64a995d4fULL, PROFILE_CHIP8}, // Sequence Shoot [J. Weisbecker]
+    {0x4baf9e72329a0a16ULL, PROFILE_CHIP8}, // Slide [Joyce Weisbecker]
+    {0x847ee1947d13f660ULL, PROFILE_CHIP8}, // Sum Fun [Joyce Weisbecker]
+    {0xd5b2025c097ff3c8ULL, PROFILE_CHIP8_HIRES}, // Astro Dodge Hires
+    {0x12c494214cc7867eULL, PROFILE_CHIP8_HIRES}, // Hires Maze
+    {0x07d4c57228fdfd3fULL, PROFILE_CHIP8_HIRES}, // Hires Particle Demo
+    {0x5f70283339f07dd6ULL, PROFILE_CHIP8_HIRES}, // Hires Sierpinski
+    {0x7733653c794f141bULL, PROFILE_CHIP8_HIRES}, // Hires Stars
+    {0x7f24d3f86f020231ULL, PROFILE_CHIP8_HIRES}, // Hires Test [Tom Swan]
+    {0x236b116b881deae1ULL, PROFILE_CHIP8_HIRES}, // Hires Worm V4
+    {0x9522b3b785c678a2ULL, PROFILE_CHIP8_HIRES}, // Trip8 Hires Demo
+    {0xec7ca0de3e110327ULL, PROFILE_SCHIP}, // Syzygy [Roy Trevino, 1990]
+    {0x04eb2109dc29b1abULL, PROFILE_SCHIP}, // Tetris [Fran Dachille, 1991]
+    {0x8d8a02fa3a2ed293ULL, PROFILE_SCHIP}, // UFO [Lutz V, 1992]
+};
+
+Profile rom_profile(uint64_t rom_hash) {
+  for (const auto &rom : known_roms) {
+    if (rom.rom_hash == rom_hash) {
+      return rom.profile;
+    }
+  }
+  return PROFILE_DEFAULT;
+}
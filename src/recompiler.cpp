@@ -0,0 +1,262 @@
+#include "chip8.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+// Block recompiler. Straight-line runs of instructions are decoded once into
+// a Block of handler/operand pairs and then replayed without any per
+// instruction fetch, cache lookup or pc bookkeeping. Blocks reuse the same
+// opcode handlers as the interpreter, so the two cannot disagree on what an
+// instruction does, only on which instruction runs next.
+
+// Instructions that end a block: unconditional transfers (nothing after
+// them runs next), DXYN, SUPER-CHIP's exit, and memory stores, which may
+// rewrite the code being executed. Skips and FX0A stay inside the block as
+// side exits. Decided on the opcode alone, for every platform at once.
+bool Chip8::ends_block(uint16_t inst) {
+  switch ((inst >> 12) & 0x0F) {
+  case 0x00:
+    return (inst & 0x00FF) == 0xEE || (inst & 0x00FF) == 0xFD;
+  case 0x01:
+  case 0x02:
+  case 0x0B:
+  case 0x0D:
+    return true;
+  case 0x05:
+    return (inst & 0x000F) == 0x2; // XO-CHIP 5XY2
+  case 0x0F:
+    switch (inst & 0x00FF) {
+    case 0x33:
+    case 0x55:
+      return true;
+    default:
+      return false;
+    }
+  default:
+    return false;
+  }
+}
+
+// Instructions whose only effects are on V0-VF, I and pc. Everything else
+// touches memory, the screen, the stack, the timers, the RNG or the audio
+// and flag registers.
+bool Chip8::is_register_only(uint16_t inst) {
+  switch ((inst >> 12) & 0x0F) {
+  case 0x00:
+  case 0x02:
+  case 0x0C:
+  case 0x0D:
+    return false;
+  case 0x05:
+    return (inst & 0x000F) != 0x2;
+  case 0x0F:
+    switch (inst & 0x00FF) {
+    case 0x01:
+    case 0x02:
+    case 0x15:
+    case 0x18:
+    case 0x33:
+    case 0x3A:
+    case 0x55:
+    case 0x75:
+      return false;
+    default:
+      return true;
+    }
+  default:
+    return true;
+  }
+}
+
+// Nothing past mem_size is ever compiled, so only that much is cleared.
+void Chip8::flush_blocks() {
+  memset(this->blocks, 0, this->mem_size * sizeof(this->blocks[0]));
+  this->block_ops.clear();
+  memset(this->block_code, false, this->mem_size);
+  this->blocks_stale = false;
+}
+
+// Decodes the block starting at pc into blocks[pc].
+void Chip8::compile_block(uint16_t pc) {
+  Block &block = this->blocks[pc];
+  block.length = 0;
+  block.pure = 0;
+  block.first = (uint32_t)this->block_ops.size();
+
+  uint16_t addr = pc;
+  while ((size_t)addr + 1 < this->mem_size &&
+         block.length < MAX_BLOCK_LENGTH) {
+    const Instruction op =
+        split((this->mem[addr] << 8) | (this->mem[addr + 1]));
+    this->block_ops.push_back({this->decoder(op.inst), op});
+    if (block.pure == block.length && is_register_only(op.inst)) {
+      block.pure++;
+    }
+    this->block_code[addr] = true;
+    this->block_code[addr + 1] = true;
+    block.length++;
+    addr += 2;
+    if (ends_block(op.inst)) {
+      break;
+    }
+  }
+}
+
+// Fills the decode cache for all the code analyze() found and, for the
+// recompiler, compiles a block at each of its block starts, so a ROM starts
+// without discovery work. Entries are decoded from memory as it is now, as
+// they would be on first visit, and self-modifying code still invalidates
+// them. Call after set_config(), which drops them.
+void Chip8::predecode(const Rom_graph &graph) {
+  const uint32_t end =
+      std::min<uint32_t>((uint32_t)graph.kinds.size(), this->mem_size - 1);
+  for (uint32_t addr = ROM_ENTRY_POINT; addr < end; addr++) {
+    if (graph.kinds[addr] == BYTE_CODE &&
+        this->decoded[addr].handler == nullptr) {
+      Decoded &entry = this->decoded[addr];
+      entry.op = split((this->mem[addr] << 8) | (this->mem[addr + 1]));
+      entry.handler = this->decoder(entry.op.inst);
+    }
+  }
+  if (this->config.backend != BACKEND_RECOMPILER) {
+    return;
+  }
+  if (this->blocks_stale) {
+    this->flush_blocks();
+  }
+  for (const auto &[start, block] : graph.blocks) {
+    if ((uint32_t)start + 1 < this->mem_size &&
+        this->blocks[start].length == 0) {
+      this->compile_block(start);
+    }
+  }
+}
+
+// Runs at most limit instructions of the block at pc and returns how many
+// ran. The block is left early as soon as an instruction sends pc anywhere
+// other than the next instruction (taken skip, FX0A waiting, jump, call,
+// return).
+uint32_t Chip8::execute_block(uint16_t start, uint32_t limit) {
+  const Block &block = this->blocks[start];
+  const Decoded *ops = &this->block_ops[block.first];
+  const uint32_t count = block.length < limit ? block.length : limit;
+
+  uint16_t next_pc = start;
+  uint32_t n = 0;
+  while (n < count) {
+    PROFILE_INSTRUCTION(this->profiler, next_pc, ops[n].op.inst);
+    next_pc += 2;
+    this->pc = next_pc;
+    ops[n].handler(*this, ops[n].op);
+    n++;
+    if (this->pc != next_pc) {
+      break;
+    }
+  }
+
+  this->cycle_count += n;
+  return n;
+}
+
+// Runs up to budget instructions block by block. The last block of a frame
+// is cut short at the budget, so frames execute exactly as many instructions
+// as with the interpreter.
+uint32_t Chip8::run_blocks(uint32_t budget) {
+  uint32_t executed = 0;
+  // Idle loop detection, see the end of the loop
+  uint16_t loop_pc = this->pc;
+  uint32_t loop_start = 0;
+  uint16_t loop_i = this->i;
+  uint8_t loop_gpr[16];
+  memcpy(loop_gpr, this->gpr, sizeof(loop_gpr));
+
+  while (executed < budget && this->state == EmuState::RUNNING) {
+    if (this->blocks_stale) {
+      this->flush_blocks();
+    }
+    if ((size_t)this->pc + 1 >= this->mem_size) {
+      this->cycle(); // pauses
+      break;
+    }
+
+    const uint16_t start = this->pc;
+    if (this->blocks[start].length == 0) {
+      this->compile_block(start);
+    }
+
+#ifdef CHIP8_RECOMPILER_CHECK
+    // Replay the same instructions on a copy with the reference interpreter
+    // and make sure both end up in the same state. On the heap like every
+    // machine, it is too big for a worker thread's stack.
+    auto shadow = std::make_unique<Chip8>(*this);
+    shadow->profiler = nullptr;
+#endif
+
+    const uint32_t ran = this->execute_block(start, budget - executed);
+    executed += ran;
+
+#ifdef CHIP8_RECOMPILER_CHECK
+    for (uint32_t n = 0; n < ran; n++) {
+      shadow->cycle_uncached();
+    }
+    if (!this->same_machine(*shadow)) {
+      std::cerr << "Recompiled block at 0x" << std::hex << start
+                << " diverged from the interpreter" << std::dec << std::endl;
+      std::abort();
+    }
+#endif
+
+    // DXYN ends a block, so once per block is soon enough
+    if (this->vblank_wait) {
+      break;
+    }
+
+    // Keys and timers only change between frames. If execution gets back to
+    // loop_pc with the same V0-VF and I it had last time, having run only
+    // register-only instructions in between (key or timer polling, jump to
+    // self, FX0A with no key down), it is going to go round the same loop
+    // until the frame ends, so whole trips round it are charged at once
+    // instead of spinning.
+    if (ran > this->blocks[start].pure ||
+        executed - loop_start > MAX_IDLE_LOOP) {
+      loop_pc = this->pc;
+      loop_start = executed;
+      loop_i = this->i;
+      memcpy(loop_gpr, this->gpr, sizeof(loop_gpr));
+    } else if (this->pc == loop_pc) {
+      if (this->i == loop_i &&
+          memcmp(loop_gpr, this->gpr, sizeof(loop_gpr)) == 0) {
+        const uint32_t period = executed - loop_start;
+        const uint32_t skipped = (budget - executed) / period * period;
+        this->cycle_count += skipped;
+        executed += skipped;
+        PROFILE_SKIPPED(this->profiler, skipped);
+      }
+      loop_start = executed;
+      loop_i = this->i;
+      memcpy(loop_gpr, this->gpr, sizeof(loop_gpr));
+    }
+  }
+
+  return executed;
+}
+
+// Compares everything a program can observe: registers, timers, stack,
+// memory, the framebuffer and the SUPER-CHIP/XO-CHIP extras.
+bool Chip8::same_machine(const Chip8 &other) const {
+  return this->state == other.state && this->pc == other.pc &&
+         this->i == other.i && this->sp == other.sp &&
+         this->delay == other.delay && this->sound == other.sound &&
+         this->rng_state == other.rng_state &&
+         memcmp(this->gpr, other.gpr, sizeof(this->gpr)) == 0 &&
+         memcmp(this->stack, other.stack, sizeof(this->stack)) == 0 &&
+         memcmp(this->mem, other.mem, sizeof(this->mem)) == 0 &&
+         memcmp(this->display, other.display, sizeof(this->display)) == 0 &&
+         this->resolution == other.resolution &&
+         this->planes == other.planes && this->pitch == other.pitch &&
+         memcmp(this->rpl, other.rpl, sizeof(this->rpl)) == 0 &&
+         memcmp(this->pattern, other.pattern, sizeof(this->pattern)) == 0;
+}
@@ -0,0 +1,185 @@
+#include "rewind.hpp"
+#include <cstdint>
+#include <cstring>
+
+// Delta records are a list of (uint16_t word index, uint64_t xor) pairs
+#define DELTA_RECORD 10
+#define SNAPSHOT_WORDS (sizeof(Snapshot) / sizeof(uint64_t))
+
+static_assert(sizeof(Snapshot) % sizeof(uint64_t) == 0,
+              "Snapshot must be a whole number of words");
+static_assert(SNAPSHOT_WORDS <= UINT16_MAX,
+              "Delta records index words with a uint16_t");
+
+// frames: how many frames to keep at most. keyframe_interval: frames
+// between full snapshots. arena_bytes: storage for the encoded frames;
+// must hold at least a couple of keyframes.
+Rewind::Rewind(uint32_t frames, uint32_t keyframe_interval,
+               size_t arena_bytes)
+    : entries(frames), arena(arena_bytes), oldest(0), next(0), head(0),
+      keyframe_interval(keyframe_interval), key_seq(UINT64_MAX) {}
+
+Rewind_entry &Rewind::entry(uint64_t seq) {
+  return this->entries[seq % this->entries.size()];
+}
+
+// Drops the oldest frame. Dropping a keyframe drops every delta against it
+// as well, so the oldest stored frame is always a keyframe.
+void Rewind::drop_oldest() {
+  const uint64_t dropped_key = this->entry(this->oldest).key;
+  this->oldest++;
+  while (this->oldest < this->next &&
+         this->entry(this->oldest).key == dropped_key) {
+    this->oldest++;
+  }
+  if (this->key_seq < this->oldest) {
+    this->key_seq = UINT64_MAX;
+  }
+}
+
+// Finds room for size bytes after the newest frame, wrapping to the start
+// of the arena if needed and dropping old frames that are in the way.
+uint32_t Rewind::reserve(uint32_t size) {
+  if (this->head + size > this->arena.size()) {
+    this->head = 0;
+  }
+  while (this->oldest < this->next) {
+    const Rewind_entry &old = this->entry(this->oldest);
+    if (old.offset >= this->head + size || this->head >= old.offset + old.size) {
+      break;
+    }
+    this->drop_oldest();
+  }
+  const uint32_t offset = this->head;
+  this->head += size;
+  return offset;
+}
+
+// Makes this->key hold keyframe seq.
+bool Rewind::load_key(uint64_t seq) {
+  if (this->key_seq == seq) {
+    return true;
+  }
+  if (seq < this->oldest || seq >= this->next) {
+    return false;
+  }
+  memcpy(&this->key, &this->arena[this->entry(seq).offset],
+         this->entry(seq).size);
+  this->key_seq = seq;
+  return true;
+}
+
+// Stores the state of the frame that just finished.
+void Rewind::push(const Snapshot &snapshot) {
+  if (this->entries.empty() || this->arena.size() < 2 * sizeof(Snapshot)) {
+    return;
+  }
+  if (this->next - this->oldest == this->entries.size()) {
+    this->drop_oldest();
+  }
+
+  const uint64_t seq = this->next;
+  const uint32_t key_size = (uint32_t)snapshot_size(snapshot);
+  // Bigger deltas than this are stored as keyframes
+  const uint32_t max_delta = key_size / 4;
+  bool keyframe = true;
+  uint8_t delta[sizeof(Snapshot) / 4 + DELTA_RECORD];
+  uint32_t delta_size = 0;
+
+  // Encode against the newest keyframe if it is recent enough and the same
+  // size
+  if (this->oldest < this->next) {
+    const uint64_t last_key = this->entry(this->next - 1).key;
+    if (seq - last_key < this->keyframe_interval && this->load_key(last_key) &&
+        snapshot_size(this->key) == key_size) {
+      keyframe = false;
+      const uint8_t *now = reinterpret_cast<const uint8_t *>(&snapshot);
+      const uint8_t *base = reinterpret_cast<const uint8_t *>(&this->key);
+      for (uint16_t word = 0; word < key_size / 8; word++) {
+        uint64_t a, b;
+        memcpy(&a, now + word * 8, 8);
+        memcpy(&b, base + word * 8, 8);
+        if (a == b) {
+          continue;
+        }
+        if (delta_size + DELTA_RECORD > max_delta) {
+          keyframe = true; // changed too much, not worth a delta
+          break;
+        }
+        const uint64_t x = a ^ b;
+        memcpy(delta + delta_size, &word, 2);
+        memcpy(delta + delta_size + 2, &x, 8);
+        delta_size += DELTA_RECORD;
+      }
+    }
+  }
+
+  const uint32_t size = keyframe ? key_size : delta_size;
+  const uint32_t offset = this->reserve(size);
+
+  // reserve() may have dropped the keyframe the delta was made against
+  if (!keyframe && this->key_seq == UINT64_MAX) {
+    this->head = offset;
+    this->next = seq;
+    this->push(snapshot);
+    return;
+  }
+
+  Rewind_entry &stored = this->entry(seq);
+  stored.offset = offset;
+  stored.size = size;
+  if (keyframe) {
+    stored.key = seq;
+    memcpy(&this->arena[offset], &snapshot, key_size);
+    memcpy(&this->key, &snapshot, key_size);
+    this->key_seq = seq;
+  } else {
+    stored.key = this->key_seq;
+    memcpy(&this->arena[offset], delta, delta_size);
+  }
+  this->next++;
+}
+
+// Removes the newest stored frame and decodes it into snapshot. Returns
+// false when there is nothing left to rewind to.
+bool Rewind::pop(Snapshot &snapshot) {
+  if (this->oldest == this->next) {
+    return false;
+  }
+  const uint64_t seq = this->next - 1;
+  const Rewind_entry stored = this->entry(seq);
+  if (!this->load_key(stored.key)) {
+    this->clear();
+    return false;
+  }
+
+  memcpy(&snapshot, &this->key, snapshot_size(this->key));
+  uint8_t *out = reinterpret_cast<uint8_t *>(&snapshot);
+  for (uint32_t pos = 0; stored.key != seq && pos < stored.size;
+       pos += DELTA_RECORD) {
+    uint16_t word;
+    uint64_t x, value;
+    memcpy(&word, &this->arena[stored.offset + pos], 2);
+    memcpy(&x, &this->arena[stored.offset + pos + 2], 8);
+    memcpy(&value, out + word * 8, 8);
+    value ^= x;
+    memcpy(out + word * 8, &value, 8);
+  }
+
+  // Give the space back
+  this->next = seq;
+  this->head = stored.offset;
+  if (this->key_seq == seq) {
+    this->key_seq = UINT64_MAX;
+  }
+  return true;
+}
+
+// Number of frames that can be rewound.
+uint32_t Rewind::size() const { return (uint32_t)(this->next - this->oldest); }
+
+void Rewind::clear() {
+  this->oldest = this->next;
+  this->head = 0;
+  this->key_seq = UINT64_MAX;
+}
@@ -0,0 +1,166 @@
+#include "rom.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+#if defined(_WIN32)
+#include <new>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+uint64_t rom_hash(const uint8_t *data, uint32_t size) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (uint32_t byte = 0; byte < size; byte++) {
+    hash ^= data[byte];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+Rom_file::Rom_file(const char *path)
+    : rom({nullptr, 0, 0}), error("can't open"), mapping(nullptr),
+      mapped_size(0) {
+#if defined(_WIN32)
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return;
+  }
+  const auto size = file.tellg();
+  if (size <= 0) {
+    this->error = "empty";
+    return;
+  }
+  if (size > ROM_MAX_SIZE) {
+    this->error = "too big";
+    return;
+  }
+  uint8_t *copy = new (std::nothrow) uint8_t[(size_t)size];
+  file.seekg(0);
+  if (copy == nullptr || !file.read(reinterpret_cast<char *>(copy), size)) {
+    delete[] copy;
+    this->error = "can't read";
+    return;
+  }
+  this->mapping = copy;
+  this->mapped_size = (size_t)size;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    this->error = "not a file";
+  } else if (st.st_size == 0) {
+    this->error = "empty";
+  } else if (st.st_size > ROM_MAX_SIZE) {
+    this->error = "too big";
+  } else {
+    void *mapped =
+        mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      this->error = "can't map";
+    } else {
+      this->mapping = mapped;
+      this->mapped_size = (size_t)st.st_size;
+    }
+  }
+  close(fd);
+  if (this->mapping == nullptr) {
+    return;
+  }
+#endif
+  this->rom.data = static_cast<const uint8_t *>(this->mapping);
+  this->rom.size = (uint32_t)this->mapped_size;
+  this->rom.hash = rom_hash(this->rom.data, this->rom.size);
+  this->error = nullptr;
+}
+
+const Rom *Rom_file::get() const {
+  return this->error == nullptr ? &this->rom : nullptr;
+}
+
+const char *Rom_file::why_not() const {
+  return this->error != nullptr ? this->error : "loaded";
+}
+
+Rom_file::~Rom_file() {
+#if defined(_WIN32)
+  delete[] static_cast<uint8_t *>(this->mapping);
+#else
+  if (this->mapping) {
+    munmap(this->mapping, this->mapped_size);
+  }
+#endif
+}
+
+const Rom *Rom_library::load_locked(const std::string &path,
+                                    const char **error) {
+  auto file = this->files.find(path);
+  if (file == this->files.end()) {
+    file = this->files.emplace(path, std::make_unique<Rom_file>(path.c_str()))
+               .first;
+    if (const Rom *rom = file->second->get()) {
+      this->catalog.emplace(rom->hash,
+                            Rom_entry{rom->hash, rom->size,
+                                      rom_profile(rom->hash), path});
+    }
+  }
+  if (error != nullptr) {
+    *error = file->second->why_not();
+  }
+  return file->second->get();
+}
+
+const Rom *Rom_library::load(const std::string &path, const char **error) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  return this->load_locked(path, error);
+}
+
+uint32_t Rom_library::scan(const std::string &dir) {
+  std::vector<std::string> paths;
+  std::error_code error;
+  for (const auto &entry :
+       std::filesystem::recursive_directory_iterator(dir, error)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".ch8") {
+      paths.push_back(entry.path().string());
+    }
+  }
+  std::sort(paths.begin(), paths.end());
+
+  std::lock_guard<std::mutex> guard(this->lock);
+  uint32_t added = 0;
+  for (const std::string &path : paths) {
+    if (this->files.count(path) == 0 && this->load_locked(path, nullptr)) {
+      added++;
+    }
+  }
+  return added;
+}
+
+const Rom *Rom_library::find(uint64_t hash) {
+  std::lock_guard<std::mutex> guard(this->lock);
+  auto entry = this->catalog.find(hash);
+  if (entry == this->catalog.end()) {
+    return nullptr;
+  }
+  return this->load_locked(entry->second.path, nullptr);
+}
+
+std::vector<Rom_entry> Rom_library::entries() const {
+  std::lock_guard<std::mutex> guard(this->lock);
+  std::vector<Rom_entry> list;
+  for (const auto &[hash, entry] : this->catalog) {
+    list.push_back(entry);
+  }
+  std::sort(list.begin(), list.end(),
+            [](const Rom_entry &a, const Rom_entry &b) {
+              return a.path < b.path;
+            });
+  return list;
+}
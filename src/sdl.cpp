@@ -1,13 +1,34 @@
 #include "sdl.hpp"
+#include "framebuffer.hpp"
 #include "SDL3/SDL_audio.h"
 #include "SDL3/SDL_init.h"
 #include "SDL3/SDL_log.h"
 #include "SDL3/SDL_render.h"
 #include "SDL3/SDL_video.h"
-#include "structs.hpp"
+#include <algorithm>
+#include <bit>
 #include <cstdint>
 
-bool SDL_app::platform_init_audio() {
+// Runs on SDL's audio thread whenever the device wants more: drains the
+// ring, and pads with silence when the emulator hasn't produced enough.
+static void SDLCALL feed_audio(void *userdata, SDL_AudioStream *stream,
+                               int additional_amount, int) {
+  Audio_ring *ring = (Audio_ring *)userdata;
+  float samples[256];
+  int needed = additional_amount / (int)sizeof(float);
+  while (needed > 0) {
+    const uint32_t count = (uint32_t)std::min(needed, 256);
+    for (uint32_t n = ring->read(samples, count); n < count; n++) {
+      samples[n] = 0.0f;
+    }
+    SDL_PutAudioStreamData(stream, samples, count * sizeof(float));
+    needed -= count;
+  }
+}
+
+// Starts playing what gets written to ring. Without audio the emulator
+// still runs, silently.
+bool SDL_app::init_audio(Audio_ring &ring) {
   if (!SDL_InitSubSystem(SDL_INIT_AUDIO)) {
     SDL_Log("Audio init failed: %s", SDL_GetError());
     return false;
@@ -16,10 +37,10 @@ bool SDL_app::platform_init_audio() {
   SDL_AudioSpec spec{};
   spec.channels = 1;
   spec.format = SDL_AUDIO_F32;
-  spec.freq = SAMPLE_RATE;
+  spec.freq = AUDIO_SAMPLE_RATE;
 
   audio_stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK,
-                                           &spec, nullptr, nullptr);
+                                           &spec, feed_audio, &ring);
 
   if (!audio_stream) {
     SDL_Log("Failed to open audio stream: %s", SDL_GetError());
@@ -30,31 +51,6 @@ bool SDL_app::platform_init_audio() {
   return true;
 }
 
-void SDL_app::generate_beep() {
-  if (!s_should_beep_play.load())
-    return;
-
-  const int samples_per_chunk = 256;
-  float samples[samples_per_chunk];
-
-  for (int i = 0; i < samples_per_chunk; ++i) {
-    const float phase = (float)wave_sample * BEEP_FREQUENCY / SAMPLE_RATE;
-
-    samples[i] =
-        (SDL_sinf(phase * 2.0f * SDL_PI_F) > 0.0f) ? AMPLITUDE : -AMPLITUDE;
-
-    wave_sample++;
-  }
-
-  wave_sample %= SAMPLE_RATE;
-
-  SDL_PutAudioStreamData(audio_stream, samples, sizeof(samples));
-}
-
-void SDL_app::platform_start_beep() { s_should_beep_play.store(true); }
-
-void SDL_app::platform_stop_beep() { s_should_beep_play.store(false); }
-
 SDL_AppResult SDL_app::init(uint32_t width, uint32_t height,
                             uint32_t scaling_factor) {
   if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO)) {
@@ -77,6 +73,16 @@ SDL_AppResult SDL_app::init(uint32_t width, uint32_t height,
   }
   SDL_SetRenderDrawBlendMode(this->state.renderer, SDL_BLENDMODE_NONE);
 
+  this->state.texture =
+      SDL_CreateTexture(this->state.renderer, SDL_PIXELFORMAT_RGBA8888,
+                        SDL_TEXTUREACCESS_STREAMING, DISPLAY_WIDTH,
+                        DISPLAY_HEIGHT);
+  if (!this->state.texture) {
+    SDL_Log("Texture creation failed: %s\n", SDL_GetError());
+    return SDL_APP_FAILURE;
+  }
+  SDL_SetTextureScaleMode(this->state.texture, SDL_SCALEMODE_NEAREST);
+
   return SDL_APP_CONTINUE;
 }
 
@@ -86,9 +92,10 @@ SDL_app::~SDL_app() {
 
   SDL_QuitSubSystem(SDL_INIT_AUDIO);
 
-  SDL_QuitSubSystem(SDL_INIT_AUDIO);
-  SDL_DestroyWindow(this->state.window);
+  if (this->state.texture)
+    SDL_DestroyTexture(this->state.texture);
   SDL_DestroyRenderer(this->state.renderer);
+  SDL_DestroyWindow(this->state.window);
   SDL_Quit();
 }
 
@@ -103,46 +110,39 @@ void SDL_app::clear_screen(uint32_t bg_color) {
   SDL_RenderClear(this->state.renderer);
 }
 
-void SDL_app::update_screen(uint32_t fg_color, uint32_t bg_color,
-                            uint32_t scaling_factor, bool display[32][64]) {
-  SDL_FRect pixel_rect = {
-      .x = 0,
-      .y = 0,
-      .w = static_cast<float>(scaling_factor),
-      .h = static_cast<float>(scaling_factor),
-  };
-
-  // Foreground color components
-  const uint8_t fg_r = (fg_color >> 24) & 0xFF;
-  const uint8_t fg_g = (fg_color >> 16) & 0xFF;
-  const uint8_t fg_b = (fg_color >> 8) & 0xFF;
-  const uint8_t fg_a = (fg_color >> 0) & 0xFF;
-
-  // Background color components (used for outline if enabled, or drawing "off"
-  // pixels)
-  const uint8_t bg_r = (bg_color >> 24) & 0xFF;
-  const uint8_t bg_g = (bg_color >> 16) & 0xFF;
-  const uint8_t bg_b = (bg_color >> 8) & 0xFF;
-  const uint8_t bg_a = (bg_color >> 0) & 0xFF;
-
-  for (uint32_t row = 0; row < 32; row++) {
-    pixel_rect.y = row * scaling_factor;
-    for (uint32_t col = 0; col < 64; col++) {
-      pixel_rect.x = col * scaling_factor;
-      if (display[row][col]) { // If the CHIP-8 pixel is "on"
-        SDL_SetRenderDrawColor(this->state.renderer, fg_r, fg_g, fg_b, fg_a);
-        SDL_RenderFillRect(this->state.renderer, &pixel_rect);
-
-        // if (outline) { // Optionally draw an outline for "on" pixels
-        //   SDL_SetRenderDrawColor(this->state.renderer, bg_r, bg_g, bg_b,
-        //       bg_a); // Outline with background color
-        //   SDL_RenderDrawRect(this->state.renderer, &pixel_rect);
-        // }
-      } else { // If the CHIP-8 pixel is "off"
-        SDL_SetRenderDrawColor(this->state.renderer, bg_r, bg_g, bg_b, bg_a);
-        SDL_RenderFillRect(this->state.renderer, &pixel_rect);
+// Re-expands the rows set in dirty_rows, uploads the span of texture rows
+// covering them and presents the texture with a single scaled copy. The
+// texture is always 128x64; smaller modes are expanded to fill it.
+void SDL_app::update_screen(const uint32_t palette[4], const Display &display,
+                            Resolution resolution, uint64_t dirty_rows) {
+  const uint32_t height = resolution_height(resolution);
+  const uint32_t scale_y = DISPLAY_HEIGHT / height;
+  if (height < 64) {
+    dirty_rows &= (1ULL << height) - 1;
+  }
+  if (dirty_rows) {
+    const int first = std::countr_zero(dirty_rows);
+    const int last = 63 - std::countl_zero(dirty_rows);
+
+    for (int row = first; row <= last; row++) {
+      if ((dirty_rows >> row) & 1) {
+        expand_rows(display, resolution, row, 1, palette,
+                    &this->pixels[row * scale_y * DISPLAY_WIDTH]);
       }
     }
+
+    const SDL_Rect rect = {
+        .x = 0,
+        .y = (int)(first * scale_y),
+        .w = DISPLAY_WIDTH,
+        .h = (int)((last - first + 1) * scale_y),
+    };
+    SDL_UpdateTexture(this->state.texture, &rect,
+                      &this->pixels[first * scale_y * DISPLAY_WIDTH],
+                      DISPLAY_WIDTH * sizeof(uint32_t));
   }
+
+  SDL_RenderTexture(this->state.renderer, this->state.texture, nullptr,
+                    nullptr);
   SDL_RenderPresent(this->state.renderer); // Show the drawn frame
 }
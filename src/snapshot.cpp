@@ -0,0 +1,187 @@
+#include "snapshot.hpp"
+#include "chip8.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(_WIN32)
+#include <new>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Copies the whole machine into snapshot. No allocation, one memcpy of
+// the memory the platform has and a few small ones.
+void Chip8::save_state(Snapshot &snapshot) const {
+  snapshot.magic = SNAPSHOT_MAGIC;
+  snapshot.version = SNAPSHOT_VERSION;
+  snapshot.platform = (uint32_t)this->config.platform;
+  snapshot.mem_size = this->mem_size;
+  memcpy(snapshot.mem, this->mem, this->mem_size);
+  memcpy(snapshot.display, this->display, sizeof(snapshot.display));
+  memcpy(snapshot.stack, this->stack, sizeof(snapshot.stack));
+  snapshot.pc = this->pc;
+  snapshot.i = this->i;
+  memcpy(snapshot.gpr, this->gpr, sizeof(snapshot.gpr));
+  snapshot.sp = this->sp;
+  snapshot.delay = this->delay;
+  snapshot.sound = this->sound;
+  snapshot.state = (uint8_t)this->state;
+  snapshot.keypad = this->get_keys();
+  snapshot.is_sound_active = this->is_sound_active;
+  snapshot.resolution = (uint8_t)this->resolution;
+  snapshot.rng_state = this->rng_state;
+  snapshot.cycle_count = this->cycle_count;
+  snapshot.frame_count = this->frame_count;
+  snapshot.machine_cycles = this->machine_cycles;
+  snapshot.cycle_debt = this->cycle_debt;
+  snapshot.planes = this->planes;
+  snapshot.pitch = this->pitch;
+  memset(snapshot.reserved, 0, sizeof(snapshot.reserved));
+  memcpy(snapshot.rpl, this->rpl, sizeof(snapshot.rpl));
+  memcpy(snapshot.pattern, this->pattern, sizeof(snapshot.pattern));
+}
+
+// Restores the machine from snapshot. Memory is compared in 64 byte chunks
+// and only bytes that differ are written (through write_mem, so cached
+// decodes and blocks over them are dropped). Restoring a snapshot taken from
+// the same program therefore costs little more than the copy itself.
+// Snapshots this machine couldn't have saved are refused: another platform
+// or memory size, a stack deeper than its own, an unknown resolution,
+// planes or state, or a random number generator stuck at 0.
+bool Chip8::load_state(const Snapshot &snapshot) {
+  if (snapshot.magic != SNAPSHOT_MAGIC ||
+      snapshot.version != SNAPSHOT_VERSION ||
+      snapshot.platform != (uint32_t)this->config.platform ||
+      snapshot.mem_size != this->mem_size ||
+      snapshot.sp >= this->stack_size || snapshot.resolution > RES_HIRES ||
+      snapshot.planes >= 1 << DISPLAY_PLANES ||
+      snapshot.state > EmuState::QUIT || snapshot.rng_state == 0) {
+    return false;
+  }
+
+  for (uint32_t addr = 0; addr < this->mem_size; addr += 64) {
+    if (memcmp(this->mem + addr, snapshot.mem + addr, 64) == 0) {
+      continue;
+    }
+    for (uint32_t byte = addr; byte < addr + 64; byte++) {
+      if (this->mem[byte] != snapshot.mem[byte]) {
+        this->write_mem(byte, snapshot.mem[byte]);
+      }
+    }
+  }
+
+  memcpy(this->display, snapshot.display, sizeof(this->display));
+  memcpy(this->stack, snapshot.stack, sizeof(this->stack));
+  this->pc = snapshot.pc;
+  this->i = snapshot.i;
+  memcpy(this->gpr, snapshot.gpr, sizeof(this->gpr));
+  this->sp = snapshot.sp;
+  this->delay = snapshot.delay;
+  this->sound = snapshot.sound;
+  this->state = (EmuState)snapshot.state;
+  this->set_keys(snapshot.keypad);
+  this->is_sound_active = snapshot.is_sound_active;
+  this->rng_state = snapshot.rng_state;
+  this->cycle_count = snapshot.cycle_count;
+  this->frame_count = snapshot.frame_count;
+  this->machine_cycles = snapshot.machine_cycles;
+  this->cycle_debt = snapshot.cycle_debt;
+  this->frame_spent = 0; // a frame held by the debugger starts over
+  this->resolution = (Resolution)snapshot.resolution;
+  this->planes = snapshot.planes;
+  this->pitch = snapshot.pitch;
+  memcpy(this->rpl, snapshot.rpl, sizeof(this->rpl));
+  memcpy(this->pattern, snapshot.pattern, sizeof(this->pattern));
+
+  PROFILE_LOST_STACK(this->profiler);
+
+  // The whole picture may have changed
+  this->frame_dirty = 0;
+  this->dirty_rows = ~0ULL;
+  this->display_version++;
+  return true;
+}
+
+size_t snapshot_size(const Snapshot &snapshot) {
+  return offsetof(Snapshot, mem) +
+         std::min<size_t>(snapshot.mem_size, sizeof(snapshot.mem));
+}
+
+uint64_t snapshot_hash(const Snapshot &snapshot) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&snapshot);
+  const size_t size = snapshot_size(snapshot);
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t byte = 0; byte < size; byte++) {
+    hash ^= bytes[byte];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+bool save_snapshot_file(const char *path, const Snapshot &snapshot) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  file.write(reinterpret_cast<const char *>(&snapshot),
+             (std::streamsize)snapshot_size(snapshot));
+  return file.good();
+}
+
+Snapshot_file::Snapshot_file(const char *path)
+    : snapshot(nullptr), mapped_size(0) {
+#if defined(_WIN32)
+  std::ifstream file(path, std::ios::binary);
+  Snapshot *copy = new (std::nothrow) Snapshot;
+  if (copy) {
+    file.read(reinterpret_cast<char *>(copy), sizeof(Snapshot));
+  }
+  if (copy && file.gcount() >= (std::streamsize)offsetof(Snapshot, mem) &&
+      file.gcount() >= (std::streamsize)snapshot_size(*copy)) {
+    this->snapshot = copy;
+  } else {
+    delete copy;
+  }
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  // Mapped as a whole Snapshot, of which a 4 KB machine's file only has
+  // the start; the rest is never read
+  struct stat st;
+  if (fstat(fd, &st) == 0 &&
+      (size_t)st.st_size >= offsetof(Snapshot, mem)) {
+    void *mapped =
+        mmap(nullptr, sizeof(Snapshot), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED &&
+        (size_t)st.st_size >=
+            snapshot_size(*static_cast<const Snapshot *>(mapped))) {
+      this->snapshot = static_cast<const Snapshot *>(mapped);
+      this->mapped_size = sizeof(Snapshot);
+    } else if (mapped != MAP_FAILED) {
+      munmap(mapped, sizeof(Snapshot));
+    }
+  }
+  close(fd);
+#endif
+}
+
+const Snapshot *Snapshot_file::get() const { return this->snapshot; }
+
+Snapshot_file::~Snapshot_file() {
+#if defined(_WIN32)
+  delete this->snapshot;
+#else
+  if (this->snapshot) {
+    munmap(const_cast<Snapshot *>(this->snapshot), this->mapped_size);
+  }
+#endif
+}
@@ -0,0 +1,88 @@
+#include "timing.hpp"
+#include "chip8.hpp"
+#include <cstdint>
+
+// Cycles of the routine behind each opcode, after dispatch
+static uint32_t vip_execute_cycles(const Instruction &op) {
+  switch (op.inst >> 12) {
+  case 0x0:
+    switch (op.inst) {
+    case 0x00E0:
+      return 24;
+    case 0x00EE:
+      return 10;
+    default: // machine code call, not run
+      return 6;
+    }
+  case 0x1:
+    return 12;
+  case 0x2:
+    return 26;
+  case 0x3:
+  case 0x4:
+    return 10;
+  case 0x5:
+  case 0x9:
+    return 14;
+  case 0x6:
+    return 6;
+  case 0x7:
+    return 10;
+  case 0x8:
+    return 44;
+  case 0xA:
+    return 12;
+  case 0xB:
+    return 22;
+  case 0xC:
+    return 36;
+  case 0xD:
+    return 26 + 16 * op.n; // per row: shift the sprite byte, XOR two bytes
+  case 0xE:
+    return 14;
+  default: // 0xF
+    switch (op.nn) {
+    case 0x1E:
+      return 16;
+    case 0x29:
+      return 20;
+    case 0x33:
+      return 84 + 40 * 3; // repeated subtraction, per digit
+    case 0x55:
+    case 0x65:
+      return 14 + 14 * (op.x + 1);
+    default: // FX07, FX0A (per poll), FX15, FX18
+      return 10;
+    }
+  }
+}
+
+uint32_t vip_cycles(const Instruction &op) {
+  return VIP_FETCH_CYCLES + vip_execute_cycles(op);
+}
+
+// Runs one frame's worth of VIP machine cycles through the decode cache.
+// An instruction that runs past the end of the frame finishes, and the
+// cycles it overran come off the next frame. DXYN waits for the next
+// vertical blank before it draws, so it idles away the rest of the frame
+// and its drawing is charged to the next one: at most one sprite per frame,
+// as on the VIP. Returns the number of instructions executed.
+uint32_t Chip8::run_cycles(uint32_t budget) {
+  uint32_t executed = 0;
+  uint32_t spent = this->cycle_debt;
+  while (spent < budget && this->state == EmuState::RUNNING) {
+    if ((size_t)this->pc + 1 >= this->mem_size) {
+      this->cycle();
+      break;
+    }
+    const Instruction op =
+        split((this->mem[this->pc] << 8) | this->mem[this->pc + 1]);
+    const uint32_t cost = vip_cycles(op);
+    this->cycle();
+    executed++;
+    this->machine_cycles += cost;
+    spent = (op.inst >> 12) == 0xD ? budget + cost : spent + cost;
+  }
+  this->cycle_debt = spent > budget ? spent - budget : 0;
+  return executed;
+}
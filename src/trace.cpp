@@ -0,0 +1,137 @@
+#include "trace.hpp"
+#include "chip8.hpp"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+Tracer::Tracer(const char *path, const Chip8 &chip)
+    : ring(TRACE_RING_RECORDS), mask(TRACE_RING_RECORDS - 1), unpublished(0),
+      free_until(TRACE_RING_RECORDS), head(0), tail(0), stopping(false),
+      failed(false), file(std::fopen(path, "wb")) {
+  if (this->file == nullptr) {
+    return;
+  }
+  const Trace_header header = {TRACE_MAGIC, TRACE_VERSION,
+                               chip.get_rom_hash(),
+                               (uint32_t)chip.get_config().platform,
+                               chip.get_config().quirks};
+  if (std::fwrite(&header, sizeof(header), 1, this->file) != 1) {
+    this->failed = true;
+  }
+  this->writer = std::thread(&Tracer::drain, this);
+}
+
+bool Tracer::ok() const { return this->file != nullptr && !this->failed; }
+
+// The ring is full as far as the producer knew. Hands over what it has and
+// waits for the writer to free some space.
+void Tracer::make_room() {
+  this->publish();
+  while (true) {
+    this->free_until = this->tail.load(std::memory_order_acquire) +
+                       (uint32_t)this->ring.size();
+    if (this->free_until != this->unpublished) {
+      return;
+    }
+    std::this_thread::yield();
+  }
+}
+
+void Tracer::frame(uint64_t frame) {
+  this->record((uint16_t)frame, (uint16_t)(frame >> 16), TRACE_FRAME,
+               (uint16_t)(frame >> 32), 0);
+  this->publish();
+}
+
+void Tracer::publish() {
+  this->head.store(this->unpublished, std::memory_order_release);
+}
+
+// Writer thread: writes whatever has been published, in as few writes as
+// the ring's wraparound allows, until finish() and the ring is empty. After
+// a failed write it keeps draining so the emulation thread never waits on
+// a dead file.
+void Tracer::drain() {
+  const uint32_t capacity = (uint32_t)this->ring.size();
+  while (true) {
+    const bool last = this->stopping.load(std::memory_order_acquire);
+    const uint32_t tail = this->tail.load(std::memory_order_relaxed);
+    const uint32_t head = this->head.load(std::memory_order_acquire);
+    if (head == tail) {
+      if (last) {
+        return;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    const uint32_t start = tail & this->mask;
+    const uint32_t count = std::min(head - tail, capacity - start);
+    if (!this->failed &&
+        std::fwrite(&this->ring[start], sizeof(Trace_record), count,
+                    this->file) != count) {
+      this->failed = true;
+    }
+    this->tail.store(tail + count, std::memory_order_release);
+  }
+}
+
+bool Tracer::finish() {
+  if (this->file == nullptr) {
+    return false;
+  }
+  if (this->writer.joinable()) {
+    this->publish();
+    this->stopping.store(true, std::memory_order_release);
+    this->writer.join();
+  }
+  if (std::fclose(this->file) != 0) {
+    this->failed = true;
+  }
+  this->file = nullptr;
+  return !this->failed;
+}
+
+Tracer::~Tracer() { this->finish(); }
+
+// Records the instruction at pc that just ran, given V0-VF and I from before
+// it, with the first register it changed.
+void Chip8::trace(uint16_t pc, uint16_t inst, const uint8_t *gpr,
+                  uint16_t i) {
+  uint8_t reg = TRACE_REG_NONE;
+  uint16_t value = 0;
+  // V0-VF as two words, XORed against before: changed bytes are nonzero
+  uint64_t before[2];
+  uint64_t after[2];
+  memcpy(before, gpr, sizeof(before));
+  memcpy(after, this->gpr, sizeof(after));
+  for (uint32_t half = 0; half < 2; half++) {
+    uint64_t changed = before[half] ^ after[half];
+    if (changed == 0) {
+      continue;
+    }
+    if (reg != TRACE_REG_NONE) {
+      reg |= TRACE_MORE;
+      break;
+    }
+    reg = (uint8_t)(half * 8 + std::countr_zero(changed) / 8); // little endian
+    value = this->gpr[reg];
+    changed &= ~(0xFFULL << (reg % 8 * 8));
+    if (changed != 0) {
+      reg |= TRACE_MORE;
+      break;
+    }
+  }
+  if (this->i != i) {
+    if (reg == TRACE_REG_NONE) {
+      reg = TRACE_REG_I;
+      value = this->i;
+    } else {
+      reg |= TRACE_MORE;
+    }
+  }
+  this->tracer->record(pc, inst, reg, value, this->sp);
+}
+
+void Chip8::set_tracer(Tracer *tracer) { this->tracer = tracer; }
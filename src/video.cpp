@@ -0,0 +1,396 @@
+#include "video.hpp"
+#include "chip8.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#define GIF_MAX_DELAY 0xFFFF // 1/100 s
+
+bool video_format(const char *path, Video_format &format) {
+  const size_t length = strlen(path);
+  if (strcmp(path, "-") == 0 ||
+      (length > 4 && strcmp(path + length - 4, ".y4m") == 0)) {
+    format = VIDEO_Y4M;
+    return true;
+  }
+  if (length > 4 && strcmp(path + length - 4, ".gif") == 0) {
+    format = VIDEO_GIF;
+    return true;
+  }
+  return false;
+}
+
+Video_writer::Video_writer(const char *path, Video_format format,
+                           uint32_t scale, const config_t &config, bool drop)
+    : queue(VIDEO_QUEUE_PICTURES), mask(VIDEO_QUEUE_PICTURES - 1), pending(),
+      has_pending(false), pending_version(0), drop(drop), dropped(0), head(0),
+      tail(0),
+      stopping(false), failed(false), format(format),
+      scale(std::clamp<uint32_t>(scale, 1, VIDEO_MAX_SCALE)),
+      width(DISPLAY_WIDTH * this->scale),
+      height(DISPLAY_HEIGHT * this->scale),
+      palette{config.bg_color, config.fg_color, config.plane2_color,
+              config.overlap_color},
+      file(nullptr), expanded(DISPLAY_WIDTH * DISPLAY_HEIGHT),
+      pixels(this->width * this->height),
+      previous(DISPLAY_WIDTH * DISPLAY_HEIGHT), written_frames(0),
+      has_previous(false) {
+  if (strcmp(path, "-") == 0) {
+#if defined(_WIN32)
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    this->file = stdout;
+  } else {
+    this->file = std::fopen(path, "wb");
+  }
+  if (this->file == nullptr) {
+    return;
+  }
+  this->write_header();
+  this->writer = std::thread(&Video_writer::drain, this);
+}
+
+bool Video_writer::ok() const { return this->file != nullptr && !this->failed; }
+
+// Unchanged pictures only add a frame to pending. A new one queues pending
+// first, waiting for room, or with drop keeps showing it one more frame.
+void Video_writer::frame(const Chip8 &chip) {
+  const uint64_t version = chip.get_display_version();
+  if (this->has_pending &&
+      this->pending.resolution == chip.get_resolution() &&
+      (version == this->pending_version ||
+       memcmp(this->pending.display, chip.get_display(), sizeof(Display)) ==
+           0)) {
+    this->pending.frames++;
+    this->pending_version = version;
+    return;
+  }
+  if (this->has_pending && !this->push()) {
+    if (this->drop) {
+      this->pending.frames++;
+      this->dropped++;
+      return;
+    }
+    while (!this->push()) {
+      std::this_thread::yield();
+    }
+  }
+  memcpy(this->pending.display, chip.get_display(), sizeof(Display));
+  this->pending.resolution = chip.get_resolution();
+  this->pending.frames = 1;
+  this->pending_version = version;
+  this->has_pending = true;
+}
+
+bool Video_writer::push() {
+  const uint32_t head = this->head.load(std::memory_order_relaxed);
+  if (head - this->tail.load(std::memory_order_acquire) ==
+      this->queue.size()) {
+    return false;
+  }
+  this->queue[head & this->mask] = this->pending;
+  this->head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+// Writer thread: encodes queued pictures until finish() and the queue is
+// empty. After a failed write it keeps taking pictures off the queue so
+// the emulation thread never finds it full for good.
+void Video_writer::drain() {
+  while (true) {
+    const bool last = this->stopping.load(std::memory_order_acquire);
+    const uint32_t tail = this->tail.load(std::memory_order_relaxed);
+    if (this->head.load(std::memory_order_acquire) == tail) {
+      if (last) {
+        return;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    if (!this->failed) {
+      this->write_picture(this->queue[tail & this->mask]);
+    }
+    this->tail.store(tail + 1, std::memory_order_release);
+  }
+}
+
+void Video_writer::write(const void *data, size_t size) {
+  if (!this->failed && std::fwrite(data, 1, size, this->file) != size) {
+    this->failed = true;
+  }
+}
+
+static void put_u16(std::vector<uint8_t> &out, uint32_t value) {
+  out.push_back((uint8_t)value);
+  out.push_back((uint8_t)(value >> 8));
+}
+
+void Video_writer::write_header() {
+  if (this->format == VIDEO_Y4M) {
+    char header[96];
+    const int length = snprintf(header, sizeof(header),
+                                "YUV4MPEG2 W%u H%u F60:1 Ip A1:1 C420jpeg "
+                                "XCOLORRANGE=FULL\n",
+                                this->width, this->height);
+    this->write(header, (size_t)length);
+    return;
+  }
+
+  // GIF89a, a 4 color global table, and looping forever
+  std::vector<uint8_t> out = {'G', 'I', 'F', '8', '9', 'a'};
+  put_u16(out, this->width);
+  put_u16(out, this->height);
+  out.insert(out.end(), {0xF1, 0, 0}); // global table of 2^(1+1) entries
+  for (uint32_t color : this->palette) {
+    out.insert(out.end(), {(uint8_t)(color >> 24), (uint8_t)(color >> 16),
+                           (uint8_t)(color >> 8)});
+  }
+  static const char loop[] = "\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00";
+  out.insert(out.end(), loop, loop + sizeof(loop) - 1);
+  this->write(out.data(), out.size());
+}
+
+void Video_writer::write_picture(const Video_picture &picture) {
+  // The display as palette indices, 128x64 whatever the mode
+  static const uint32_t identity[4] = {0, 1, 2, 3};
+  expand_rows(picture.display, picture.resolution, 0,
+              resolution_height(picture.resolution), identity,
+              this->expanded.data());
+  if (this->format == VIDEO_GIF) {
+    this->write_gif(picture.frames);
+  } else {
+    this->write_y4m(picture.frames);
+  }
+}
+
+// GIF's LZW for 2-bit pixels: codes start 3 bits wide, grow to 12, and the
+// table starts over with a clear code once it is full.
+static void gif_lzw(const uint8_t *pixels, size_t count,
+                    std::vector<uint8_t> &out) {
+  const uint32_t clear = 4;
+  const uint32_t end = 5;
+  std::vector<uint16_t> table(4096 * 4, 0); // [code][pixel] -> code, 0 none
+  uint32_t next = end + 1;
+  uint32_t width = 3;
+  uint32_t bits = 0;
+  uint32_t pending_bits = 0;
+  auto emit = [&](uint32_t code) {
+    bits |= code << pending_bits;
+    pending_bits += width;
+    while (pending_bits >= 8) {
+      out.push_back((uint8_t)bits);
+      bits >>= 8;
+      pending_bits -= 8;
+    }
+  };
+
+  out.clear();
+  emit(clear);
+  uint32_t prefix = pixels[0];
+  for (size_t n = 1; n < count; n++) {
+    const uint32_t pixel = pixels[n];
+    const uint16_t longer = table[prefix * 4 + pixel];
+    if (longer != 0) {
+      prefix = longer;
+      continue;
+    }
+    emit(prefix);
+    if (next < 4096) {
+      table[prefix * 4 + pixel] = (uint16_t)next;
+      // The decoder adds this code a step later, and widens then
+      if (next == (1u << width)) {
+        width++;
+      }
+      next++;
+    } else {
+      emit(clear);
+      std::fill(table.begin(), table.end(), 0);
+      next = end + 1;
+      width = 3;
+    }
+    prefix = pixel;
+  }
+  emit(prefix);
+  // The decoder adds a code for that last one too before reading on
+  if (next == (1u << width) && width < 12) {
+    width++;
+  }
+  emit(end);
+  if (pending_bits > 0) {
+    out.push_back((uint8_t)bits);
+  }
+}
+
+// One GIF image: the rectangle that changed since the last picture (all of
+// it the first time), shown for frames 60Hz frames. Delays are rounded so
+// they add up to the emulated time.
+void Video_writer::write_gif(uint32_t frames) {
+  uint32_t left = DISPLAY_WIDTH;
+  uint32_t right = 0;
+  uint32_t top = DISPLAY_HEIGHT;
+  uint32_t bottom = 0;
+  for (uint32_t y = 0; y < DISPLAY_HEIGHT; y++) {
+    for (uint32_t x = 0; x < DISPLAY_WIDTH; x++) {
+      const uint8_t index = (uint8_t)this->expanded[y * DISPLAY_WIDTH + x];
+      if (this->has_previous &&
+          this->previous[y * DISPLAY_WIDTH + x] == index) {
+        continue;
+      }
+      this->previous[y * DISPLAY_WIDTH + x] = index;
+      left = std::min(left, x);
+      right = std::max(right, x + 1);
+      top = std::min(top, y);
+      bottom = std::max(bottom, y + 1);
+    }
+  }
+  this->has_previous = true;
+  if (left >= right) {
+    // Different bits, same colors: a pixel that didn't change
+    left = 0;
+    right = 1;
+    top = 0;
+    bottom = 1;
+  }
+
+  auto centiseconds = [](uint64_t count) { return (count * 100 + 30) / 60; };
+  uint64_t delay = centiseconds(this->written_frames + frames) -
+                   centiseconds(this->written_frames);
+  this->written_frames += frames;
+
+  std::vector<uint8_t> out;
+  while (true) {
+    const uint32_t rect_width = (right - left) * this->scale;
+    const uint32_t rect_height = (bottom - top) * this->scale;
+    uint8_t *rect = this->pixels.data();
+    for (uint32_t y = 0; y < rect_height; y++) {
+      const uint32_t *row =
+          this->expanded.data() + (top + y / this->scale) * DISPLAY_WIDTH;
+      for (uint32_t x = 0; x < rect_width; x++) {
+        *rect++ = (uint8_t)row[left + x / this->scale];
+      }
+    }
+    gif_lzw(this->pixels.data(), (size_t)rect_width * rect_height,
+            this->encoded);
+
+    const uint32_t shown = (uint32_t)std::min<uint64_t>(delay, GIF_MAX_DELAY);
+    // Graphic control (leave the image in place, the delay), then the image
+    out.assign({0x21, 0xF9, 0x04, 0x04});
+    put_u16(out, shown);
+    out.insert(out.end(), {0, 0, 0x2C});
+    put_u16(out, left * this->scale);
+    put_u16(out, top * this->scale);
+    put_u16(out, rect_width);
+    put_u16(out, rect_height);
+    out.insert(out.end(), {0, 2}); // no local table, 2-bit codes
+    for (size_t pos = 0; pos < this->encoded.size(); pos += 255) {
+      const size_t length = std::min<size_t>(255, this->encoded.size() - pos);
+      out.push_back((uint8_t)length);
+      out.insert(out.end(), this->encoded.begin() + pos,
+                 this->encoded.begin() + pos + length);
+    }
+    out.push_back(0);
+    this->write(out.data(), out.size());
+
+    // Longer than a GIF delay holds: the rest as one unchanged pixel
+    delay -= shown;
+    if (delay == 0) {
+      return;
+    }
+    left = 0;
+    right = 1;
+    top = 0;
+    bottom = 1;
+  }
+}
+
+// A Y4M frame for each 60Hz frame: full-range BT.601 luma, then chroma
+// averaged over 2x2 pixels. A picture shown for several frames is
+// converted once and written that many times.
+void Video_writer::write_y4m(uint32_t frames) {
+  uint8_t luma[4];
+  int32_t blue[4];
+  int32_t red[4];
+  for (uint32_t index = 0; index < 4; index++) {
+    const int32_t r = (uint8_t)(this->palette[index] >> 24);
+    const int32_t g = (uint8_t)(this->palette[index] >> 16);
+    const int32_t b = (uint8_t)(this->palette[index] >> 8);
+    luma[index] = (uint8_t)((77 * r + 150 * g + 29 * b + 128) >> 8);
+    blue[index] = -43 * r - 85 * g + 128 * b;
+    red[index] = 128 * r - 107 * g - 21 * b;
+  }
+
+  const uint32_t chroma_width = this->width / 2;
+  const uint32_t chroma_height = this->height / 2;
+  this->encoded.resize(6 + this->width * this->height +
+                       2 * chroma_width * chroma_height);
+  memcpy(this->encoded.data(), "FRAME\n", 6);
+  uint8_t *y_plane = this->encoded.data() + 6;
+  uint8_t *u_plane = y_plane + this->width * this->height;
+  uint8_t *v_plane = u_plane + chroma_width * chroma_height;
+
+  for (uint32_t y = 0; y < this->height; y++) {
+    const uint32_t *row =
+        this->expanded.data() + (y / this->scale) * DISPLAY_WIDTH;
+    uint8_t *index = this->pixels.data() + y * this->width;
+    for (uint32_t x = 0; x < this->width; x++) {
+      index[x] = (uint8_t)row[x / this->scale];
+      y_plane[y * this->width + x] = luma[index[x]];
+    }
+  }
+  for (uint32_t y = 0; y < chroma_height; y++) {
+    const uint8_t *above = this->pixels.data() + 2 * y * this->width;
+    const uint8_t *below = above + this->width;
+    for (uint32_t x = 0; x < chroma_width; x++) {
+      const uint8_t quad[4] = {above[2 * x], above[2 * x + 1], below[2 * x],
+                               below[2 * x + 1]};
+      int32_t u = 0;
+      int32_t v = 0;
+      for (uint8_t index : quad) {
+        u += blue[index];
+        v += red[index];
+      }
+      // Sum of four, each 256 times too big: divide by 1024, rounding
+      u_plane[y * chroma_width + x] =
+          (uint8_t)std::clamp(128 + ((u + 512) >> 10), 0, 255);
+      v_plane[y * chroma_width + x] =
+          (uint8_t)std::clamp(128 + ((v + 512) >> 10), 0, 255);
+    }
+  }
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    this->write(this->encoded.data(), this->encoded.size());
+  }
+}
+
+bool Video_writer::finish() {
+  if (this->file == nullptr) {
+    return false;
+  }
+  if (this->writer.joinable()) {
+    // The last picture has nothing after it to be dropped for
+    while (this->has_pending && !this->push()) {
+      std::this_thread::yield();
+    }
+    this->has_pending = false;
+    this->stopping.store(true, std::memory_order_release);
+    this->writer.join();
+  }
+  if (this->format == VIDEO_GIF) {
+    this->write(";", 1); // trailer
+  }
+  if ((this->file == stdout ? std::fflush(this->file)
+                            : std::fclose(this->file)) != 0) {
+    this->failed = true;
+  }
+  this->file = nullptr;
+  return !this->failed;
+}
+
+uint64_t Video_writer::get_dropped() const { return this->dropped; }
+
+Video_writer::~Video_writer() { this->finish(); }
@@ -0,0 +1,68 @@
+#include "work_pool.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// threads == 0 uses one worker per hardware thread.
+Work_pool::Work_pool(uint32_t threads) : threads(threads) {
+  if (this->threads == 0) {
+    this->threads = std::thread::hardware_concurrency();
+  }
+  if (this->threads == 0) {
+    this->threads = 1;
+  }
+  this->queues = std::make_unique<Queue[]>(this->threads);
+}
+
+uint32_t Work_pool::size() const { return this->threads; }
+
+// Next job for worker: its own oldest one, or else the newest one of the
+// first other worker that still has any.
+bool Work_pool::take(uint32_t worker, size_t &job) {
+  {
+    Queue &own = this->queues[worker];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.jobs.empty()) {
+      job = own.jobs.front();
+      own.jobs.pop_front();
+      return true;
+    }
+  }
+  for (uint32_t n = 1; n < this->threads; n++) {
+    Queue &victim = this->queues[(worker + n) % this->threads];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.jobs.empty()) {
+      job = victim.jobs.back();
+      victim.jobs.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+void Work_pool::run(size_t count,
+                    const std::function<void(size_t, uint32_t)> &job) {
+  // Jobs never get added while running, so once every queue is seen empty
+  // the worker is done.
+  for (uint32_t worker = 0; worker < this->threads; worker++) {
+    const size_t first = count * worker / this->threads;
+    const size_t last = count * (worker + 1) / this->threads;
+    for (size_t index = first; index < last; index++) {
+      this->queues[worker].jobs.push_back(index);
+    }
+  }
+
+  std::vector<std::thread> workers;
+  for (uint32_t worker = 0; worker < this->threads; worker++) {
+    workers.emplace_back([this, worker, &job]() {
+      size_t index;
+      while (this->take(worker, index)) {
+        job(index, worker);
+      }
+    });
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}